@@ -0,0 +1,264 @@
+// microbenchmark and accuracy check for the gaussian blur
+// times one horizontal + vertical box blur (boxBlurTransposed twice) at a few radii for each simd level,
+// then runs blur() at every blur factor the editor allows and checks that all simd levels give the same
+// bytes and that on average they're no further than --tolerance from a gaussian computed directly in double
+// precision (the biggest difference gets reported too, but with only three boxes the small blur factors
+// can be a fair way off on hard edges). pixels close enough to the edges for the box passes to reach past them are left out of that, since
+// each pass repeats the edge pixels of an already blurred image, which a single gaussian can't match.
+// prints the results as JSON, and exits with 1 if the check fails
+//
+// usage: bench_blur [--size 256|1080p|4k|8k] [--radii 1,4,16,64] [--reps <n>] [--threads <n>] [--tolerance <n>] [-o <file>]
+
+#include "filters.hh"
+#include "blur_helper.hh"
+#include "synthetic_image.hh"
+#include "thread_pool.hh"
+#include "simd_helper.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchSize {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const BenchSize benchSizes[] = {
+    {"256", 256, 256},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+};
+
+// the blur factor slider's range
+#define MIN_BLUR_FACTOR 1
+#define MAX_BLUR_FACTOR 8
+
+// size of the image the accuracy check runs on
+#define CHECK_WIDTH 640
+#define CHECK_HEIGHT 480
+
+struct BenchOptions {
+    BenchSize size = benchSizes[2];
+    std::vector<int> radii = {1, 4, 16, 64};
+    int reps = 5;
+    int threads = 0; // 0 = one per hardware thread
+    double tolerance = 2.0; // how far blur() can be from the reference gaussian on average
+    std::string outputFile;
+};
+
+static bool parseArgs(int argc, char** argv, BenchOptions& options){
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        if(i + 1 >= argc){
+            std::cerr << "usage: bench_blur [--size 256|1080p|4k|8k] [--radii 1,4,16,64] [--reps <n>] [--threads <n>] [--tolerance <n>] [-o <file>]\n";
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if(arg == "--size"){
+            bool found = false;
+            for(const BenchSize& s : benchSizes){
+                if(std::string(value) == s.name){
+                    options.size = s;
+                    found = true;
+                }
+            }
+            if(!found){
+                std::cerr << "unknown size: " << value << "\n";
+                return false;
+            }
+        }else if(arg == "--radii"){
+            options.radii.clear();
+            std::stringstream radiusList(value);
+            std::string radius;
+            while(std::getline(radiusList, radius, ',')){
+                options.radii.push_back(std::max(0, std::atoi(radius.c_str())));
+            }
+        }else if(arg == "--reps"){
+            options.reps = std::max(1, std::atoi(value));
+        }else if(arg == "--threads"){
+            options.threads = std::max(0, std::atoi(value));
+        }else if(arg == "--tolerance"){
+            options.tolerance = std::max(0.0, std::atof(value));
+        }else if(arg == "-o"){
+            options.outputFile = value;
+        }else{
+            std::cerr << "unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// gaussian blur of the rgb channels by direct convolution out to 4 standard deviations, with
+// pixels past the edges counting as copies of the edge ones like the box passes do
+static void referenceGaussBlur(const unsigned char* src, unsigned char* dst, int width, int height, double stdDev){
+    int radius = (int)std::ceil(4 * stdDev);
+    std::vector<double> kernel(2 * radius + 1);
+    double kernelSum = 0;
+    for(int k = -radius; k <= radius; k++){
+        kernel[k + radius] = std::exp(-(k * k) / (2 * stdDev * stdDev));
+        kernelSum += kernel[k + radius];
+    }
+    for(double& weight : kernel){
+        weight /= kernelSum;
+    }
+
+    std::vector<double> horizontal(4 * (size_t)width * height);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            for(int c = 0; c < 3; c++){
+                double sum = 0;
+                for(int k = -radius; k <= radius; k++){
+                    int col = std::min(std::max(x + k, 0), width - 1);
+                    sum += kernel[k + radius] * src[4 * ((size_t)y * width + col) + c];
+                }
+                horizontal[4 * ((size_t)y * width + x) + c] = sum;
+            }
+        }
+    }
+
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            size_t pixel = 4 * ((size_t)y * width + x);
+            for(int c = 0; c < 3; c++){
+                double sum = 0;
+                for(int k = -radius; k <= radius; k++){
+                    int row = std::min(std::max(y + k, 0), height - 1);
+                    sum += kernel[k + radius] * horizontal[4 * ((size_t)row * width + x) + c];
+                }
+                dst[pixel + c] = (unsigned char)correctRGB((int)std::lround(sum));
+            }
+            dst[pixel + 3] = src[pixel + 3];
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    if(!parseArgs(argc, argv, options)){
+        return 1;
+    }
+
+    setThreadCount(options.threads);
+    SimdLevel supported = getSupportedSimdLevel();
+
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"bench_blur\",\n  \"reps\": " << options.reps << ",\n  \"threads\": " << getThreadCount()
+         << ",\n  \"size\": \"" << options.size.name << "\",\n  \"box_passes\": [";
+
+    // box passes: one horizontal pass into the transposed buffer and one back
+    int width = options.size.width;
+    int height = options.size.height;
+    double numPixels = (double)width * height;
+    std::vector<unsigned char> imageData(4 * (size_t)width * height);
+    std::vector<unsigned char> transposed(imageData.size());
+    generateSyntheticImage(imageData.data(), width, height, 1234);
+
+    bool first = true;
+    for(int level = SimdLevel::Scalar; level <= supported; level++){
+        setSimdLevel(static_cast<SimdLevel>(level));
+        for(int radius : options.radii){
+            double best = 0;
+            for(int rep = 0; rep < options.reps; rep++){
+                auto start = std::chrono::steady_clock::now();
+                boxBlurTransposed(imageData.data(), transposed.data(), width, height, radius, false);
+                boxBlurTransposed(transposed.data(), imageData.data(), height, width, radius, true);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if(rep == 0 || elapsed.count() < best){
+                    best = elapsed.count();
+                }
+            }
+
+            double mpixPerSecond = numPixels / best / 1e6;
+            std::cerr << "box pass r=" << radius << " (" << getSimdLevelName(static_cast<SimdLevel>(level)) << "): " << mpixPerSecond << " MP/s\n";
+            json << (first ? "\n" : ",\n");
+            first = false;
+            json << "    {\"simd\": \"" << getSimdLevelName(static_cast<SimdLevel>(level)) << "\", \"radius\": " << radius
+                 << ", \"best_ms\": " << best * 1000.0
+                 << ", \"mpix_per_s\": " << mpixPerSecond
+                 << ", \"ns_per_pixel\": " << best * 1e9 / numPixels << "}";
+        }
+    }
+    json << "\n  ],\n  \"reference_check\": [";
+
+    // accuracy: blur() at each level against the scalar result and the reference gaussian
+    size_t checkLen = 4 * (size_t)CHECK_WIDTH * CHECK_HEIGHT;
+    std::vector<unsigned char> source(checkLen);
+    std::vector<unsigned char> reference(checkLen);
+    std::vector<unsigned char> scalarResult(checkLen);
+    std::vector<unsigned char> result(checkLen);
+    generateSyntheticImage(source.data(), CHECK_WIDTH, CHECK_HEIGHT, 1234);
+
+    bool passed = true;
+    for(int blurFactor = MIN_BLUR_FACTOR; blurFactor <= MAX_BLUR_FACTOR; blurFactor++){
+        referenceGaussBlur(source.data(), reference.data(), CHECK_WIDTH, CHECK_HEIGHT, blurFactor);
+
+        FilterParameters params;
+        params.blurFactor = blurFactor;
+        bool levelsMatch = true;
+        for(int level = SimdLevel::Scalar; level <= supported; level++){
+            setSimdLevel(static_cast<SimdLevel>(level));
+            std::vector<unsigned char>& output = (level == SimdLevel::Scalar) ? scalarResult : result;
+            std::copy(source.begin(), source.end(), output.begin());
+            blur(output.data(), CHECK_WIDTH, CHECK_HEIGHT, params);
+            if(level != SimdLevel::Scalar && output != scalarResult){
+                levelsMatch = false;
+            }
+        }
+
+        std::vector<int> boxes = generateGaussBoxes((float)blurFactor, 3);
+        int margin = 0;
+        for(int box : boxes){
+            margin += (box - 1) / 2;
+        }
+
+        int maxDiff = 0;
+        double totalDiff = 0;
+        for(int y = margin; y < CHECK_HEIGHT - margin; y++){
+            for(int x = margin; x < CHECK_WIDTH - margin; x++){
+                for(int c = 0; c < 3; c++){
+                    size_t i = 4 * ((size_t)y * CHECK_WIDTH + x) + c;
+                    int diff = std::abs((int)scalarResult[i] - (int)reference[i]);
+                    maxDiff = std::max(maxDiff, diff);
+                    totalDiff += diff;
+                }
+            }
+        }
+        double meanDiff = totalDiff / (3.0 * (CHECK_WIDTH - 2 * margin) * (CHECK_HEIGHT - 2 * margin));
+
+        // alpha is left alone everywhere
+        for(size_t i = 3; i < checkLen; i += 4){
+            if(scalarResult[i] != source[i]){
+                levelsMatch = false;
+            }
+        }
+
+        bool ok = levelsMatch && meanDiff <= options.tolerance;
+        passed = passed && ok;
+        std::cerr << "blur factor " << blurFactor << ": max diff " << maxDiff << ", mean diff " << meanDiff
+                  << (levelsMatch ? "" : ", simd levels differ") << (ok ? "" : " FAILED") << "\n";
+        json << (blurFactor == MIN_BLUR_FACTOR ? "\n" : ",\n");
+        json << "    {\"blur_factor\": " << blurFactor << ", \"max_diff\": " << maxDiff << ", \"mean_diff\": " << meanDiff
+             << ", \"simd_levels_match\": " << (levelsMatch ? "true" : "false") << ", \"ok\": " << (ok ? "true" : "false") << "}";
+    }
+    json << "\n  ],\n  \"passed\": " << (passed ? "true" : "false") << "\n}\n";
+
+    if(options.outputFile != ""){
+        std::ofstream out(options.outputFile);
+        out << json.str();
+    }else{
+        std::cout << json.str();
+    }
+
+    return passed ? 0 : 1;
+}
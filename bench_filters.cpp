@@ -0,0 +1,299 @@
+// throughput benchmark for the filters in filters.cpp
+// runs each filter over synthetic rgba images of a few sizes and prints the results as JSON
+//
+// usage: bench_filters [--sizes 256,1080p,4k,8k] [--filters <list>] [--reps <n>] [--max-seconds <s>] [--threads <n>] [--simd scalar|sse2|avx2] [-o <file>]
+
+#include "filters.hh"
+#include "synthetic_image.hh"
+#include "thread_pool.hh"
+#include "simd_helper.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if WINDOWS_BUILD
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct BenchSize {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const BenchSize benchSizes[] = {
+    {"256", 256, 256},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+};
+
+// extra runs of a filter with parameters other than the defaults, done after the default run
+// whenever the filter is benchmarked
+struct BenchVariant {
+    Filter filter;
+    const char* name;
+    void (*setParams)(FilterParameters& params);
+};
+
+static const BenchVariant benchVariants[] = {
+    // the iterations slider's max
+    {Filter::Thinning, "100 iterations", [](FilterParameters& params){ params.thinningIterations = 100; }},
+    {Filter::Thinning, "zhang-suen", [](FilterParameters& params){ params.thinningMethod = ThinningMethod::ZhangSuen; }},
+    {Filter::Thinning, "zhang-suen 100 iterations", [](FilterParameters& params){
+        params.thinningMethod = ThinningMethod::ZhangSuen;
+        params.thinningIterations = 100;
+    }},
+    // well past the slider's max, to show the cost doesn't grow with the radius
+    {Filter::Blur, "blur factor 40", [](FilterParameters& params){ params.blurFactor = 40; }},
+    {Filter::EdgeDetection, "l1", [](FilterParameters& params){ params.edgeMagnitude = EdgeMagnitude::L1Magnitude; }},
+    {Filter::EdgeDetection, "5x5 per channel", [](FilterParameters& params){
+        params.edgeKernel = EdgeKernel::Sobel5;
+        params.edgeChannels = EdgeChannels::PerChannel;
+    }},
+};
+
+struct BenchOptions {
+    std::vector<BenchSize> sizes;
+    std::vector<Filter> filters;
+    int reps = 3;
+    double maxSeconds = 60.0; // skip a run if it's estimated to take longer than this
+    int threads = 0; // 0 = one per hardware thread
+    std::string outputFile;
+};
+
+// reset the peak resident set size so each run gets its own number (linux only)
+static void resetPeakRss(){
+#if !WINDOWS_BUILD
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    if(f != NULL){
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+// peak resident set size in kilobytes
+static long getPeakRssKb(){
+#if WINDOWS_BUILD
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))){
+        return (long)(counters.PeakWorkingSetSize / 1024);
+    }
+    return -1;
+#else
+    // VmHWM respects clear_refs, ru_maxrss doesn't
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)){
+        if(line.compare(0, 6, "VmHWM:") == 0){
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& options){
+    std::string sizes = "256,1080p,4k,8k";
+    std::string filters = "";
+
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        if(i + 1 >= argc){
+            std::cerr << "usage: bench_filters [--sizes 256,1080p,4k,8k] [--filters <list>] [--reps <n>] [--max-seconds <s>] [--threads <n>] [--simd scalar|sse2|avx2] [-o <file>]\n";
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if(arg == "--sizes"){
+            sizes = value;
+        }else if(arg == "--filters"){
+            filters = value;
+        }else if(arg == "--reps"){
+            options.reps = std::max(1, std::atoi(value));
+        }else if(arg == "--max-seconds"){
+            options.maxSeconds = std::atof(value);
+        }else if(arg == "--threads"){
+            options.threads = std::max(0, std::atoi(value));
+        }else if(arg == "--simd"){
+            SimdLevel level;
+            if(!getSimdLevelByName(value, level)){
+                std::cerr << "unknown simd level: " << value << "\n";
+                return false;
+            }
+            setSimdLevel(level);
+        }else if(arg == "-o"){
+            options.outputFile = value;
+        }else{
+            std::cerr << "unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    std::stringstream sizeList(sizes);
+    std::string name;
+    while(std::getline(sizeList, name, ',')){
+        bool found = false;
+        for(const BenchSize& s : benchSizes){
+            if(name == s.name){
+                options.sizes.push_back(s);
+                found = true;
+            }
+        }
+        if(!found){
+            std::cerr << "unknown size: " << name << "\n";
+            return false;
+        }
+    }
+
+    if(filters == ""){
+        // every filter except dots, which needs an SDL renderer
+        for(int f = Filter::Grayscale; f <= Filter::EdgeDetection; f++){
+            if(f != Filter::Dots){
+                options.filters.push_back(static_cast<Filter>(f));
+            }
+        }
+    }else{
+        std::stringstream filterList(filters);
+        while(std::getline(filterList, name, ',')){
+            Filter filter;
+            if(!getFilterByName(name, filter) || filter == Filter::Dots){
+                std::cerr << "unknown filter: " << name << "\n";
+                return false;
+            }
+            options.filters.push_back(filter);
+        }
+    }
+
+    return true;
+}
+
+// parameters that exercise each filter the way the editor's defaults would
+static FilterParameters getBenchParams(){
+    FilterParameters params;
+    params.chanOffsetRandNum = 1;
+    return params;
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    if(!parseArgs(argc, argv, options)){
+        return 1;
+    }
+
+    setThreadCount(options.threads);
+
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"bench_filters\",\n  \"reps\": " << options.reps << ",\n  \"threads\": " << getThreadCount() << ",\n  \"simd\": \"" << getSimdLevelName(getSimdLevel()) << "\",\n  \"results\": [";
+
+    // each filter's default run followed by its variants
+    std::vector<std::pair<Filter, const BenchVariant*>> runs;
+    for(Filter filter : options.filters){
+        runs.push_back({filter, nullptr});
+        for(const BenchVariant& variant : benchVariants){
+            if(variant.filter == filter){
+                runs.push_back({filter, &variant});
+            }
+        }
+    }
+
+    // seconds per pixel of the last size for each run, to estimate how long the next size will take
+    std::vector<double> secondsPerPixel(runs.size(), 0.0);
+    bool first = true;
+
+    for(const BenchSize& size : options.sizes){
+        int pixelDataLen = 4 * size.width * size.height;
+        double numPixels = (double)size.width * size.height;
+
+        std::vector<unsigned char> source(pixelDataLen);
+        std::vector<unsigned char> imageData(pixelDataLen);
+        std::vector<unsigned char> sourceImageCopy(pixelDataLen);
+        generateSyntheticImage(source.data(), size.width, size.height, 1234);
+
+        for(size_t run = 0; run < runs.size(); run++){
+            Filter filter = runs[run].first;
+            const BenchVariant* variant = runs[run].second;
+            std::string name = getFilterName(filter);
+            if(variant){
+                name += std::string(" (") + variant->name + ")";
+            }
+
+            json << (first ? "\n" : ",\n");
+            first = false;
+            json << "    {\"filter\": \"" << getFilterName(filter) << "\"";
+            if(variant){
+                json << ", \"variant\": \"" << variant->name << "\"";
+            }
+            json << ", \"size\": \"" << size.name << "\", \"width\": " << size.width << ", \"height\": " << size.height;
+
+            double estimate = secondsPerPixel[run] * numPixels * options.reps;
+            if(estimate > options.maxSeconds){
+                std::cerr << name << " @ " << size.name << ": skipped (estimated " << estimate << "s)\n";
+                json << ", \"skipped\": true, \"estimated_s\": " << estimate << "}";
+                continue;
+            }
+
+            resetPeakRss();
+
+            double best = 0;
+            double total = 0;
+            for(int rep = 0; rep < options.reps; rep++){
+                // same random numbers each rep (voronoi uses rand())
+                srand(1);
+                FilterParameters params = getBenchParams();
+                if(variant){
+                    variant->setParams(params);
+                }
+                std::copy(source.begin(), source.end(), imageData.begin());
+                std::copy(source.begin(), source.end(), sourceImageCopy.begin());
+
+                auto start = std::chrono::steady_clock::now();
+                applyFilter(filter, imageData.data(), sourceImageCopy.data(), size.width, size.height, params);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                total += elapsed.count();
+                if(rep == 0 || elapsed.count() < best){
+                    best = elapsed.count();
+                }
+            }
+
+            long peakRss = getPeakRssKb();
+            secondsPerPixel[run] = best / numPixels;
+
+            double mpixPerSecond = numPixels / best / 1e6;
+            double nsPerPixel = best * 1e9 / numPixels;
+
+            std::cerr << name << " @ " << size.name << ": " << mpixPerSecond << " MP/s\n";
+            json << ", \"best_ms\": " << best * 1000.0
+                 << ", \"mean_ms\": " << total / options.reps * 1000.0
+                 << ", \"mpix_per_s\": " << mpixPerSecond
+                 << ", \"ns_per_pixel\": " << nsPerPixel
+                 << ", \"peak_rss_kb\": " << peakRss << "}";
+        }
+    }
+
+    json << "\n  ]\n}\n";
+
+    if(options.outputFile != ""){
+        std::ofstream out(options.outputFile);
+        out << json.str();
+    }else{
+        std::cout << json.str();
+    }
+
+    return 0;
+}
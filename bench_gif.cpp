@@ -0,0 +1,672 @@
+// gif decoding benchmark for gif_helper.cpp
+// decodes an animated gif one frame at a time with getFrame() and all at once with forEachFrame()
+// at a few thread counts and simd levels, checks they all give the same frames and prints the
+// timings as JSON. without --gif it generates one from synthetic images: by default every frame
+// is whole (so they can all be decoded in parallel), with --delta only what changed gets written
+// and the frames have to be decoded one after another.
+//
+// with --verify it checks the compositing instead: it writes random small gifs (frames with offsets,
+// some sticking out past the screen, every disposal method, transparency, local color tables,
+// interlacing) and compares what GifFrameSource makes of them with frames composited directly from
+// what was written. each gif gets decoded one frame after another at every simd level, with
+// decodeFrames() and forEachFrame() on 1 and 4 threads, and in random order with some frames edited
+// in between. forEachFrame() and the random order also get run with no room in the store, the way
+// gifs too big for it get decoded.
+// it exits with 1 if any frame differs.
+//
+// usage: bench_gif [--gif <file>] [--size 256|1080p|4k] [--frames <n>] [--delta] [--threads <list>] [--reps <n>] [-o <file>]
+//        bench_gif --verify [--gifs <n>] [--seed <n>]
+
+#include "gif_helper.hh"
+#include "gif.h"
+#include "synthetic_image.hh"
+#include "thread_pool.hh"
+#include "simd_helper.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchSize {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const BenchSize benchSizes[] = {
+    {"256", 256, 256},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+struct BenchOptions {
+    std::string gifFile; // generated if empty
+    BenchSize size = benchSizes[1];
+    int numFrames = 30;
+    bool delta = false;
+    std::vector<int> threads;
+    int reps = 3;
+    std::string outputFile;
+    bool verify = false;
+    int numGifs = 200;
+    unsigned int seed = 1;
+};
+
+#define BENCH_GIF_USAGE "usage: bench_gif [--gif <file>] [--size 256|1080p|4k] [--frames <n>] [--delta] [--threads <list>] [--reps <n>] [-o <file>]\n" \
+                        "       bench_gif --verify [--gifs <n>] [--seed <n>]\n"
+
+static bool parseArgs(int argc, char** argv, BenchOptions& options){
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    std::string threads = hardwareThreads > 1 ? "1," + std::to_string(hardwareThreads) : "1";
+
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        if(arg == "--delta"){
+            options.delta = true;
+            continue;
+        }
+        if(arg == "--verify"){
+            options.verify = true;
+            continue;
+        }
+        if(i + 1 >= argc){
+            std::cerr << BENCH_GIF_USAGE;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if(arg == "--gif"){
+            options.gifFile = value;
+        }else if(arg == "--size"){
+            bool found = false;
+            for(const BenchSize& s : benchSizes){
+                if(std::string(value) == s.name){
+                    options.size = s;
+                    found = true;
+                }
+            }
+            if(!found){
+                std::cerr << "unknown size: " << value << "\n";
+                return false;
+            }
+        }else if(arg == "--frames"){
+            options.numFrames = std::max(1, std::atoi(value));
+        }else if(arg == "--threads"){
+            threads = value;
+        }else if(arg == "--reps"){
+            options.reps = std::max(1, std::atoi(value));
+        }else if(arg == "-o"){
+            options.outputFile = value;
+        }else if(arg == "--gifs"){
+            options.numGifs = std::max(1, std::atoi(value));
+        }else if(arg == "--seed"){
+            options.seed = (unsigned int)std::strtoul(value, nullptr, 10);
+        }else{
+            std::cerr << "unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    std::stringstream threadList(threads);
+    std::string count;
+    while(std::getline(threadList, count, ',')){
+        options.threads.push_back(std::max(1, std::atoi(count.c_str())));
+    }
+    return true;
+}
+
+// a synthetic image with a second one showing through a window that moves a bit every frame
+static bool writeBenchGif(const char* filename, int width, int height, int numFrames, bool delta){
+    size_t numPixels = (size_t)width * height;
+    std::vector<unsigned char> background(4 * numPixels);
+    std::vector<unsigned char> foreground(4 * numPixels);
+    std::vector<unsigned char> frame(4 * numPixels);
+    generateSyntheticImage(background.data(), width, height, 1234);
+    generateSyntheticImage(foreground.data(), width, height, 99);
+
+    GifWriter writer;
+    if(!GifBegin(&writer, filename, (uint32_t)width, (uint32_t)height, 4, !delta)){
+        return false;
+    }
+
+    int windowWidth = std::max(1, width / 4);
+    int windowHeight = std::max(1, height / 4);
+    for(int f = 0; f < numFrames; f++){
+        frame = background;
+        int left = (f * width / 32) % (width - windowWidth + 1);
+        int top = (f * height / 48) % (height - windowHeight + 1);
+        for(int y = top; y < top + windowHeight; y++){
+            size_t start = 4 * ((size_t)y * width + left);
+            std::copy(foreground.begin() + start, foreground.begin() + start + 4 * windowWidth, frame.begin() + start);
+        }
+        GifWriteFrame(&writer, (const GifRGBA*)frame.data(), (uint32_t)width, (uint32_t)height, 4);
+    }
+    return GifEnd(&writer);
+}
+
+// 64-bit FNV-1a, to compare frames without keeping them all around
+static uint64_t hashFrame(const unsigned char* pixels, size_t numBytes){
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < numBytes; i++){
+        hash = (hash ^ pixels[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// a gif for --verify, as it gets written
+struct VerifyFrame {
+    GifRect rect;                       // can stick out past the screen
+    std::vector<unsigned char> indices; // rect.width x rect.height, row after row
+    std::vector<unsigned char> palette; // local color table (rgb), empty to use the global one
+    bool hasControlBlock = false;
+    int disposal = DISPOSAL_UNSPECIFIED;
+    int transparentIndex = NO_TRANSPARENT_COLOR;
+    int delay = 0;                      // in 1/100 s
+    bool interlaced = false;
+};
+
+struct VerifyGif {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> palette; // global color table (rgb)
+    int background = 0;
+    std::vector<VerifyFrame> frames;
+};
+
+static int randomInt(std::mt19937& rng, int low, int high){
+    return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// 2 to 256 colors
+static std::vector<unsigned char> randomPalette(std::mt19937& rng){
+    std::vector<unsigned char> palette(3 << randomInt(rng, 1, 8));
+    for(unsigned char& channel : palette){
+        channel = (unsigned char)randomInt(rng, 0, 255);
+    }
+    return palette;
+}
+
+static VerifyGif randomGif(std::mt19937& rng){
+    VerifyGif gif;
+    gif.width = randomInt(rng, 1, 48);
+    gif.height = randomInt(rng, 1, 48);
+    gif.palette = randomPalette(rng);
+    gif.background = randomInt(rng, 0, (int)gif.palette.size() / 3 - 1);
+
+    int numFrames = randomInt(rng, 1, 24);
+    for(int f = 0; f < numFrames; f++){
+        VerifyFrame frame;
+        int kind = randomInt(rng, 0, 9);
+        if(f == 0 || kind < 2){
+            frame.rect.width = gif.width;
+            frame.rect.height = gif.height;
+        }else if(kind < 3){
+            // partly or entirely past the right or bottom edge
+            frame.rect.width = randomInt(rng, 1, 16);
+            frame.rect.height = randomInt(rng, 1, 16);
+            frame.rect.left = randomInt(rng, 0, gif.width + 4);
+            frame.rect.top = randomInt(rng, 0, gif.height + 4);
+        }else{
+            frame.rect.width = randomInt(rng, 1, gif.width);
+            frame.rect.height = randomInt(rng, 1, gif.height);
+            frame.rect.left = randomInt(rng, 0, gif.width - frame.rect.width);
+            frame.rect.top = randomInt(rng, 0, gif.height - frame.rect.height);
+        }
+
+        if(randomInt(rng, 0, 3) == 0){
+            frame.palette = randomPalette(rng);
+        }
+        int numColors = (int)(frame.palette.empty() ? gif.palette : frame.palette).size() / 3;
+        frame.indices.resize((size_t)frame.rect.width * frame.rect.height);
+        for(unsigned char& index : frame.indices){
+            index = (unsigned char)randomInt(rng, 0, numColors - 1);
+        }
+
+        frame.hasControlBlock = randomInt(rng, 0, 9) != 0;
+        if(frame.hasControlBlock){
+            frame.disposal = randomInt(rng, DISPOSAL_UNSPECIFIED, DISPOSE_PREVIOUS);
+            if(randomInt(rng, 0, 1)){
+                frame.transparentIndex = randomInt(rng, 0, numColors - 1);
+            }
+            frame.delay = randomInt(rng, 1, 20);
+        }
+        frame.interlaced = randomInt(rng, 0, 2) == 0;
+        gif.frames.push_back(frame);
+    }
+    return gif;
+}
+
+static void appendShort(std::vector<unsigned char>& out, int value){
+    out.push_back((unsigned char)(value & 255));
+    out.push_back((unsigned char)(value >> 8));
+}
+
+// bits per index of a color table with size bytes (3 per color)
+static int paletteBits(const std::vector<unsigned char>& palette){
+    int bits = 1;
+    while((3 << bits) < (int)palette.size()){
+        bits++;
+    }
+    return bits;
+}
+
+// lzw data for indices without any compression: a clear code every few indices keeps every code
+// at minCodeSize + 1 bits
+static void appendLzwData(std::vector<unsigned char>& out, const std::vector<unsigned char>& indices, int minCodeSize){
+    int clearCode = 1 << minCodeSize;
+    int codeBits = minCodeSize + 1;
+    int indicesPerClear = std::max(1, clearCode - 6);
+
+    std::vector<unsigned char> packed;
+    uint32_t bits = 0;
+    int numBits = 0;
+    auto writeCode = [&](int code){
+        bits |= (uint32_t)code << numBits;
+        numBits += codeBits;
+        while(numBits >= 8){
+            packed.push_back((unsigned char)(bits & 255));
+            bits >>= 8;
+            numBits -= 8;
+        }
+    };
+
+    writeCode(clearCode);
+    int sinceClear = 0;
+    for(unsigned char index : indices){
+        if(sinceClear == indicesPerClear){
+            writeCode(clearCode);
+            sinceClear = 0;
+        }
+        writeCode(index);
+        sinceClear++;
+    }
+    writeCode(clearCode + 1);
+    if(numBits > 0){
+        packed.push_back((unsigned char)(bits & 255));
+    }
+
+    out.push_back((unsigned char)minCodeSize);
+    for(size_t i = 0; i < packed.size(); i += 255){
+        size_t blockSize = std::min((size_t)255, packed.size() - i);
+        out.push_back((unsigned char)blockSize);
+        out.insert(out.end(), packed.begin() + i, packed.begin() + i + blockSize);
+    }
+    out.push_back(0);
+}
+
+static bool writeVerifyGif(const char* filename, const VerifyGif& gif){
+    std::vector<unsigned char> out = {'G', 'I', 'F', '8', '9', 'a'};
+    int globalBits = paletteBits(gif.palette);
+    appendShort(out, gif.width);
+    appendShort(out, gif.height);
+    out.push_back((unsigned char)(0x80 | ((globalBits - 1) << 4) | (globalBits - 1)));
+    out.push_back((unsigned char)gif.background);
+    out.push_back(0);
+    out.insert(out.end(), gif.palette.begin(), gif.palette.end());
+
+    for(const VerifyFrame& frame : gif.frames){
+        if(frame.hasControlBlock){
+            bool transparent = frame.transparentIndex != NO_TRANSPARENT_COLOR;
+            out.insert(out.end(), {0x21, 0xf9, 4});
+            out.push_back((unsigned char)((frame.disposal << 2) | (transparent ? 1 : 0)));
+            appendShort(out, frame.delay);
+            out.push_back((unsigned char)(transparent ? frame.transparentIndex : 0));
+            out.push_back(0);
+        }
+
+        int bits = frame.palette.empty() ? globalBits : paletteBits(frame.palette);
+        out.push_back(0x2c);
+        appendShort(out, frame.rect.left);
+        appendShort(out, frame.rect.top);
+        appendShort(out, frame.rect.width);
+        appendShort(out, frame.rect.height);
+        out.push_back((unsigned char)((frame.palette.empty() ? 0 : 0x80 | (bits - 1)) | (frame.interlaced ? 0x40 : 0)));
+        out.insert(out.end(), frame.palette.begin(), frame.palette.end());
+
+        const std::vector<unsigned char>* indices = &frame.indices;
+        std::vector<unsigned char> interlacedIndices;
+        if(frame.interlaced){
+            // every 8th row from row 0, every 8th from row 4, every 4th from row 2, every 2nd from row 1
+            static const int passStart[] = {0, 4, 2, 1};
+            static const int passStep[] = {8, 8, 4, 2};
+            for(int pass = 0; pass < 4; pass++){
+                for(int y = passStart[pass]; y < frame.rect.height; y += passStep[pass]){
+                    auto row = frame.indices.begin() + (size_t)y * frame.rect.width;
+                    interlacedIndices.insert(interlacedIndices.end(), row, row + frame.rect.width);
+                }
+            }
+            indices = &interlacedIndices;
+        }
+        appendLzwData(out, *indices, std::max(2, bits));
+    }
+    out.push_back(0x3b);
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write((const char*)out.data(), out.size());
+    return (bool)file;
+}
+
+// every frame composited onto a transparent screen one after another, following the gif89a spec
+// directly instead of going through giflib
+static std::vector<std::vector<unsigned char>> compositeVerifyGif(const VerifyGif& gif){
+    std::vector<std::vector<unsigned char>> result;
+    std::vector<unsigned char> canvas(4 * (size_t)gif.width * gif.height, 0);
+    for(const VerifyFrame& frame : gif.frames){
+        const std::vector<unsigned char>& palette = frame.palette.empty() ? gif.palette : frame.palette;
+        std::vector<unsigned char> before = canvas;
+        int right = std::min(gif.width, frame.rect.left + frame.rect.width);
+        int bottom = std::min(gif.height, frame.rect.top + frame.rect.height);
+
+        for(int y = frame.rect.top; y < bottom; y++){
+            for(int x = frame.rect.left; x < right; x++){
+                int index = frame.indices[(size_t)(y - frame.rect.top) * frame.rect.width + (x - frame.rect.left)];
+                if(index == frame.transparentIndex){
+                    continue;
+                }
+                unsigned char* pixel = &canvas[4 * ((size_t)y * gif.width + x)];
+                pixel[0] = palette[3 * index];
+                pixel[1] = palette[3 * index + 1];
+                pixel[2] = palette[3 * index + 2];
+                pixel[3] = 255;
+            }
+        }
+        result.push_back(canvas);
+
+        if(frame.disposal == DISPOSE_BACKGROUND || frame.disposal == DISPOSE_PREVIOUS){
+            for(int y = frame.rect.top; y < bottom; y++){
+                for(int x = frame.rect.left; x < right; x++){
+                    size_t offset = 4 * ((size_t)y * gif.width + x);
+                    for(int c = 0; c < 4; c++){
+                        canvas[offset + c] = frame.disposal == DISPOSE_BACKGROUND ? 0 : before[offset + c];
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// decode the gif a few different ways and count the frames that don't match expected
+static int checkVerifyGif(const char* filename, std::vector<std::vector<unsigned char>> expected, std::mt19937& rng, const std::string& name){
+    GifFrameSource source;
+    int numFrames = (int)expected.size();
+    int numMismatches = 0;
+    auto checkFrame = [&](int index, const char* mode){
+        const unsigned char* frame = source.getFrame(index);
+        if(std::memcmp(frame, expected[index].data(), expected[index].size()) != 0){
+            std::cout << "FAILED  " << name << " " << mode << ": frame " << index << " differs\n";
+            numMismatches++;
+        }
+    };
+    auto checkEveryFrame = [&](const std::string& mode){
+        int nextIndex = 0;
+        source.forEachFrame([&](int index, const unsigned char* pixels){
+            if(index != nextIndex || std::memcmp(pixels, expected[index].data(), expected[index].size()) != 0){
+                std::cout << "FAILED  " << name << " " << mode << ": frame " << index << " differs\n";
+                numMismatches++;
+            }
+            nextIndex = index + 1;
+        });
+        if(nextIndex != numFrames){
+            std::cout << "FAILED  " << name << " " << mode << ": stopped at frame " << nextIndex << "\n";
+            numMismatches++;
+        }
+    };
+    auto openSource = [&](){
+        if(!source.open(filename)){
+            std::cout << "FAILED  " << name << ": couldn't open it\n";
+            return false;
+        }
+        if(source.getWidth() * source.getHeight() * 4 != (int)expected[0].size() || source.getFrameCount() != numFrames){
+            std::cout << "FAILED  " << name << ": wrong size or frame count\n";
+            source.close();
+            return false;
+        }
+        return true;
+    };
+
+    // one frame after another
+    setThreadCount(1);
+    for(int level = SimdLevel::Scalar; level <= getSupportedSimdLevel(); level++){
+        setSimdLevel(static_cast<SimdLevel>(level));
+        if(!openSource()){
+            return numFrames;
+        }
+        for(int i = 0; i < numFrames; i++){
+            checkFrame(i, getSimdLevelName(getSimdLevel()));
+        }
+        source.close();
+    }
+    setSimdLevel(getSupportedSimdLevel());
+
+    // everything up front
+    for(int threads : {1, 4}){
+        setThreadCount(threads);
+        if(!openSource()){
+            return numFrames;
+        }
+        source.decodeFrames();
+        for(int i = numFrames - 1; i >= 0; i--){
+            checkFrame(i, threads == 1 ? "decodeFrames" : "decodeFrames 4 threads");
+        }
+        source.close();
+    }
+
+    // every frame in order, stored or (with no room in the store) handed straight over
+    size_t storeBudget = source.getStoreBudget();
+    for(bool stored : {true, false}){
+        source.setStoreBudget(stored ? storeBudget : 0);
+        for(int threads : {1, 4}){
+            setThreadCount(threads);
+            if(!openSource()){
+                return numFrames;
+            }
+            checkEveryFrame(std::string("forEachFrame") + (stored ? "" : " unstored") + (threads == 1 ? "" : " 4 threads"));
+            source.close();
+        }
+    }
+
+    // random order, with frames getting edited (a rectangle of them changed) along the way and
+    // everything else decoded halfway through, then every frame in order
+    std::vector<std::vector<unsigned char>> unedited = expected;
+    for(bool stored : {true, false}){
+        source.setStoreBudget(stored ? storeBudget : 0);
+        if(!openSource()){
+            return numFrames;
+        }
+        expected = unedited;
+        std::string mode = stored ? "random order with edits" : "random order with edits unstored";
+        int width = source.getWidth();
+        int height = source.getHeight();
+        for(int step = 0; step < 4 * numFrames; step++){
+            int index = randomInt(rng, 0, numFrames - 1);
+            if(step == 2 * numFrames){
+                source.decodeFrames();
+            }
+            if(step > numFrames && randomInt(rng, 0, 3) == 0){
+                std::vector<unsigned char>& frame = expected[index];
+                int left = randomInt(rng, 0, width - 1);
+                int top = randomInt(rng, 0, height - 1);
+                int right = randomInt(rng, left, width);
+                int bottom = randomInt(rng, top, height);
+                for(int y = top; y < bottom; y++){
+                    for(int x = left; x < right; x++){
+                        frame[4 * ((size_t)y * width + x) + randomInt(rng, 0, 3)] ^= (unsigned char)randomInt(rng, 1, 255);
+                    }
+                }
+                source.setFrame(index, frame.data());
+            }else{
+                checkFrame(index, mode.c_str());
+            }
+        }
+        checkEveryFrame(mode + " forEachFrame");
+        source.close();
+    }
+
+    return numMismatches;
+}
+
+static int runVerify(const BenchOptions& options){
+    std::mt19937 rng(options.seed);
+    const char* filename = "bench_gif.verify.tmp.gif";
+    int numFailed = 0;
+    for(int g = 0; g < options.numGifs; g++){
+        VerifyGif gif = randomGif(rng);
+        if(!writeVerifyGif(filename, gif)){
+            std::cerr << "couldn't write " << filename << "\n";
+            return 1;
+        }
+        std::string name = "gif " + std::to_string(g) + " (" + std::to_string(gif.width) + "x" + std::to_string(gif.height)
+                         + ", " + std::to_string(gif.frames.size()) + " frames)";
+        if(checkVerifyGif(filename, compositeVerifyGif(gif), rng, name) > 0){
+            numFailed++;
+        }
+    }
+    std::remove(filename);
+
+    std::cout << options.numGifs - numFailed << " of " << options.numGifs << " random gifs (seed " << options.seed << ") decoded correctly\n";
+    return numFailed > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    if(!parseArgs(argc, argv, options)){
+        return 1;
+    }
+
+    if(options.verify){
+        return runVerify(options);
+    }
+
+    std::string gifFile = options.gifFile;
+    if(gifFile == ""){
+        gifFile = "bench_gif.tmp.gif";
+        auto start = std::chrono::steady_clock::now();
+        if(!writeBenchGif(gifFile.c_str(), options.size.width, options.size.height, options.numFrames, options.delta)){
+            std::cerr << "couldn't write " << gifFile << "\n";
+            return 1;
+        }
+        std::cerr << "generated " << gifFile << " in " << secondsSince(start) << "s\n";
+    }
+
+    // the reference: every frame decoded one after another on one thread without simd
+    setThreadCount(1);
+    SimdLevel bestSimd = getSupportedSimdLevel();
+    setSimdLevel(SimdLevel::Scalar);
+
+    GifFrameSource source;
+    auto start = std::chrono::steady_clock::now();
+    if(!source.open(gifFile.c_str())){
+        std::cerr << "couldn't open " << gifFile << "\n";
+        return 1;
+    }
+    double openSeconds = secondsSince(start);
+
+    int width = source.getWidth();
+    int height = source.getHeight();
+    int numFrames = source.getFrameCount();
+    size_t frameBytes = 4 * (size_t)width * height;
+    std::vector<uint64_t> expected(numFrames);
+    for(int i = 0; i < numFrames; i++){
+        expected[i] = hashFrame(source.getFrame(i), frameBytes);
+    }
+    source.close();
+
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"bench_gif\",\n  \"gif\": \"" << (options.gifFile == "" ? (options.delta ? "generated delta" : "generated") : options.gifFile)
+         << "\",\n  \"width\": " << width << ",\n  \"height\": " << height << ",\n  \"frames\": " << numFrames
+         << ",\n  \"reps\": " << options.reps << ",\n  \"open_ms\": " << openSeconds * 1000.0 << ",\n  \"results\": [";
+
+    bool first = true;
+    bool allMatch = true;
+
+    // decode every frame with a fresh source each rep, either lazily one after another with
+    // getFrame() or all at once with forEachFrame()
+    auto runBench = [&](bool bulk){
+        double best = 0;
+        bool match = true;
+        for(int rep = 0; rep < options.reps; rep++){
+            source.open(gifFile.c_str());
+            auto decodeStart = std::chrono::steady_clock::now();
+            // checking the frames doesn't count towards the time
+            double checkSeconds = 0;
+            auto checkFrame = [&](int i, const unsigned char* frame){
+                if(rep == 0){
+                    auto checkStart = std::chrono::steady_clock::now();
+                    if(hashFrame(frame, frameBytes) != expected[i]){
+                        match = false;
+                    }
+                    checkSeconds += secondsSince(checkStart);
+                }
+            };
+            if(bulk){
+                source.forEachFrame(checkFrame);
+            }else{
+                for(int i = 0; i < numFrames; i++){
+                    checkFrame(i, source.getFrame(i));
+                }
+            }
+            double elapsed = secondsSince(decodeStart) - checkSeconds;
+            if(rep == 0 || elapsed < best){
+                best = elapsed;
+            }
+            source.close();
+        }
+        allMatch = allMatch && match;
+
+        const char* method = bulk ? "forEachFrame" : "getFrame";
+        std::cerr << method << " threads " << getThreadCount() << " " << getSimdLevelName(getSimdLevel()) << ": "
+                  << numFrames / best << " frames/s" << (match ? "" : " (frames differ!)") << "\n";
+        json << (first ? "\n" : ",\n");
+        first = false;
+        json << "    {\"method\": \"" << method << "\", \"threads\": " << getThreadCount()
+             << ", \"simd\": \"" << getSimdLevelName(getSimdLevel()) << "\""
+             << ", \"best_ms\": " << best * 1000.0
+             << ", \"frames_per_s\": " << numFrames / best
+             << ", \"mpix_per_s\": " << (double)numFrames * width * height / best / 1e6
+             << ", \"match\": " << (match ? "true" : "false") << "}";
+    };
+
+    // getFrame() only ever uses one thread
+    for(int level = SimdLevel::Scalar; level <= bestSimd; level++){
+        setSimdLevel(static_cast<SimdLevel>(level));
+        runBench(false);
+    }
+    for(int threads : options.threads){
+        setThreadCount(threads);
+        for(int level = SimdLevel::Scalar; level <= bestSimd; level++){
+            setSimdLevel(static_cast<SimdLevel>(level));
+            runBench(true);
+        }
+    }
+
+    json << "\n  ]\n}\n";
+
+    if(options.gifFile == ""){
+        std::remove(gifFile.c_str());
+    }
+
+    if(options.outputFile != ""){
+        std::ofstream out(options.outputFile);
+        out << json.str();
+    }else{
+        std::cout << json.str();
+    }
+
+    return allMatch ? 0 : 1;
+}
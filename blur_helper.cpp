@@ -0,0 +1,242 @@
+#include "blur_helper.hh"
+#include "simd_helper.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// rows blurred together. 16 rgba pixels make up one 64-byte line of the transposed output
+#define BLUR_STRIP_ROWS 16
+
+// keeps the sums (and the checks in getBoxScale) well inside 32/64 bits
+#define BLUR_MAX_RADIUS (1 << 20)
+
+// dividing a window's sum by its size d = 2 * radius + 1 and rounding to nearest is done as
+// (sum + radius) * multiplier >> shift, with multiplier = 2^shift / d rounded up.
+// multiplier * d overshoots 2^shift by at most d, so that's exactly (sum + radius) / d rounded down
+// as long as 2^shift > (255 * d + radius) * d. and since d is odd, (sum + radius) / d rounded down
+// is sum / d rounded to nearest
+struct BoxScale {
+    uint32_t multiplier;
+    int shift;
+};
+
+static BoxScale getBoxScale(int radius){
+    uint64_t size = 2 * radius + 1;
+    int shift = 0;
+    while(((uint64_t)1 << shift) <= (255 * size + radius) * size){
+        shift++;
+    }
+    return {(uint32_t)(((uint64_t)1 << shift) / size + 1), shift};
+}
+
+// the sums of the window around the first pixel of a row for each channel, plus the radius
+// for rounding (see BoxScale)
+static void startRowSums(const unsigned char* row, int width, int radius, uint32_t* sums){
+    for(int c = 0; c < 4; c++){
+        sums[c] = (radius + 1) * row[c] + radius;
+    }
+    for(int k = 1; k <= radius; k++){
+        const unsigned char* pixel = row + 4 * std::min(k, width - 1);
+        for(int c = 0; c < 4; c++){
+            sums[c] += pixel[c];
+        }
+    }
+}
+
+/***
+    scalar version, for any number of rows (also used for the last strip when the
+    height isn't a multiple of BLUR_STRIP_ROWS)
+***/
+static void boxBlurStripScalar(const unsigned char* src, unsigned char* dst, int width, int height, int radius, int firstRow, int numRows, BoxScale scale, bool keepDstAlpha){
+    uint32_t sums[BLUR_STRIP_ROWS][4];
+    const unsigned char* rows[BLUR_STRIP_ROWS];
+    for(int r = 0; r < numRows; r++){
+        rows[r] = src + 4 * ((long long)(firstRow + r) * width);
+        startRowSums(rows[r], width, radius, sums[r]);
+    }
+
+    int numChannels = keepDstAlpha ? 3 : 4;
+    for(int x = 0; x < width; x++){
+        if(x > 0){
+            int add = 4 * std::min(x + radius, width - 1);
+            int sub = 4 * std::max(x - radius - 1, 0);
+            for(int r = 0; r < numRows; r++){
+                for(int c = 0; c < 4; c++){
+                    sums[r][c] += rows[r][add + c] - rows[r][sub + c];
+                }
+            }
+        }
+
+        unsigned char* out = dst + 4 * ((long long)x * height + firstRow);
+        for(int r = 0; r < numRows; r++){
+            for(int c = 0; c < numChannels; c++){
+                out[4 * r + c] = (unsigned char)(((uint64_t)sums[r][c] * scale.multiplier) >> scale.shift);
+            }
+        }
+    }
+}
+
+#if SIMD_X86
+/***
+    SSE2 version: one pixel's 4 channels per register, one register per row
+***/
+__attribute__((target("sse2")))
+static inline __m128i loadPixelSse2(const unsigned char* pixel){
+    int value;
+    std::memcpy(&value, pixel, 4);
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero), zero);
+}
+
+// sums * multiplier >> shift in each 32-bit lane. the 64-bit products come from the even lanes,
+// then from the odd ones shifted down, and the results are small enough to fit in the low halves
+__attribute__((target("sse2")))
+static inline __m128i scaleSumsSse2(__m128i sums, __m128i multiplier, __m128i shift){
+    __m128i even = _mm_srl_epi64(_mm_mul_epu32(sums, multiplier), shift);
+    __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(sums, 32), multiplier), shift);
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+// scale the sums of 4 rows and pack them into 4 pixels
+__attribute__((target("sse2")))
+static inline __m128i packSumsSse2(const __m128i* sums, __m128i multiplier, __m128i shift){
+    __m128i a = scaleSumsSse2(sums[0], multiplier, shift);
+    __m128i b = scaleSumsSse2(sums[1], multiplier, shift);
+    __m128i c = scaleSumsSse2(sums[2], multiplier, shift);
+    __m128i d = scaleSumsSse2(sums[3], multiplier, shift);
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+__attribute__((target("sse2")))
+static void boxBlurStripSse2(const unsigned char* src, unsigned char* dst, int width, int height, int radius, int firstRow, BoxScale scale, bool keepDstAlpha){
+    __m128i sums[BLUR_STRIP_ROWS];
+    const unsigned char* rows[BLUR_STRIP_ROWS];
+    for(int r = 0; r < BLUR_STRIP_ROWS; r++){
+        rows[r] = src + 4 * ((long long)(firstRow + r) * width);
+        uint32_t rowSums[4];
+        startRowSums(rows[r], width, radius, rowSums);
+        sums[r] = _mm_loadu_si128((const __m128i*)rowSums);
+    }
+
+    const __m128i multiplier = _mm_set1_epi32((int)scale.multiplier);
+    const __m128i shift = _mm_cvtsi32_si128(scale.shift);
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+    for(int x = 0; x < width; x++){
+        if(x > 0){
+            int add = 4 * std::min(x + radius, width - 1);
+            int sub = 4 * std::max(x - radius - 1, 0);
+            for(int r = 0; r < BLUR_STRIP_ROWS; r++){
+                sums[r] = _mm_add_epi32(sums[r], _mm_sub_epi32(loadPixelSse2(rows[r] + add), loadPixelSse2(rows[r] + sub)));
+            }
+        }
+
+        __m128i* out = (__m128i*)(dst + 4 * ((long long)x * height + firstRow));
+        for(int r = 0; r < BLUR_STRIP_ROWS; r += 4){
+            __m128i result = packSumsSse2(sums + r, multiplier, shift);
+            if(keepDstAlpha){
+                result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(_mm_loadu_si128(out + r/4), alphaMask));
+            }
+            _mm_storeu_si128(out + r/4, result);
+        }
+    }
+}
+
+/***
+    AVX2 version: two rows per register (the even row in the low half)
+***/
+__attribute__((target("avx2")))
+static inline __m256i loadPixelPairAvx2(const unsigned char* low, const unsigned char* high){
+    int lowValue, highValue;
+    std::memcpy(&lowValue, low, 4);
+    std::memcpy(&highValue, high, 4);
+    return _mm256_cvtepu8_epi32(_mm_unpacklo_epi32(_mm_cvtsi32_si128(lowValue), _mm_cvtsi32_si128(highValue)));
+}
+
+// same as scaleSumsSse2
+__attribute__((target("avx2")))
+static inline __m256i scaleSumsAvx2(__m256i sums, __m256i multiplier, __m128i shift){
+    __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(sums, multiplier), shift);
+    __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sums, 32), multiplier), shift);
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+// scale the sums of 8 rows and pack them into 8 pixels. packing works within each half,
+// which leaves the pixels in the order 0 2 4 6 1 3 5 7 until the permute
+__attribute__((target("avx2")))
+static inline __m256i packSumsAvx2(const __m256i* sums, __m256i multiplier, __m128i shift){
+    __m256i low = _mm256_packs_epi32(scaleSumsAvx2(sums[0], multiplier, shift), scaleSumsAvx2(sums[1], multiplier, shift));
+    __m256i high = _mm256_packs_epi32(scaleSumsAvx2(sums[2], multiplier, shift), scaleSumsAvx2(sums[3], multiplier, shift));
+    return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+__attribute__((target("avx2")))
+static void boxBlurStripAvx2(const unsigned char* src, unsigned char* dst, int width, int height, int radius, int firstRow, BoxScale scale, bool keepDstAlpha){
+    __m256i sums[BLUR_STRIP_ROWS / 2];
+    const unsigned char* rows[BLUR_STRIP_ROWS];
+    uint32_t rowSums[BLUR_STRIP_ROWS][4];
+    for(int r = 0; r < BLUR_STRIP_ROWS; r++){
+        rows[r] = src + 4 * ((long long)(firstRow + r) * width);
+        startRowSums(rows[r], width, radius, rowSums[r]);
+    }
+    for(int r = 0; r < BLUR_STRIP_ROWS; r += 2){
+        sums[r/2] = _mm256_loadu_si256((const __m256i*)rowSums[r]);
+    }
+
+    const __m256i multiplier = _mm256_set1_epi32((int)scale.multiplier);
+    const __m128i shift = _mm_cvtsi32_si128(scale.shift);
+    const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+    for(int x = 0; x < width; x++){
+        if(x > 0){
+            int add = 4 * std::min(x + radius, width - 1);
+            int sub = 4 * std::max(x - radius - 1, 0);
+            for(int r = 0; r < BLUR_STRIP_ROWS; r += 2){
+                __m256i added = loadPixelPairAvx2(rows[r] + add, rows[r + 1] + add);
+                __m256i removed = loadPixelPairAvx2(rows[r] + sub, rows[r + 1] + sub);
+                sums[r/2] = _mm256_add_epi32(sums[r/2], _mm256_sub_epi32(added, removed));
+            }
+        }
+
+        __m256i* out = (__m256i*)(dst + 4 * ((long long)x * height + firstRow));
+        for(int r = 0; r < BLUR_STRIP_ROWS; r += 8){
+            __m256i result = packSumsAvx2(sums + r/2, multiplier, shift);
+            if(keepDstAlpha){
+                result = _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(_mm256_loadu_si256(out + r/8), alphaMask));
+            }
+            _mm256_storeu_si256(out + r/8, result);
+        }
+    }
+}
+#endif
+
+void boxBlurTransposed(const unsigned char* src, unsigned char* dst, int width, int height, int radius, bool keepDstAlpha){
+    radius = std::min(std::max(radius, 0), BLUR_MAX_RADIUS);
+    BoxScale scale = getBoxScale(radius);
+    SimdLevel level = getSimdLevel();
+
+    int numStrips = (height + BLUR_STRIP_ROWS - 1) / BLUR_STRIP_ROWS;
+    parallelFor(0, numStrips, [=](int startStrip, int endStrip){
+        for(int strip = startStrip; strip < endStrip; strip++){
+            int firstRow = strip * BLUR_STRIP_ROWS;
+            int numRows = std::min(BLUR_STRIP_ROWS, height - firstRow);
+            if(numRows < BLUR_STRIP_ROWS){
+                boxBlurStripScalar(src, dst, width, height, radius, firstRow, numRows, scale, keepDstAlpha);
+                continue;
+            }
+
+            switch(level){
+#if SIMD_X86
+                case SimdLevel::Avx2:
+                    boxBlurStripAvx2(src, dst, width, height, radius, firstRow, scale, keepDstAlpha);
+                    break;
+                case SimdLevel::Sse2:
+                    boxBlurStripSse2(src, dst, width, height, radius, firstRow, scale, keepDstAlpha);
+                    break;
+#endif
+                default:
+                    boxBlurStripScalar(src, dst, width, height, radius, firstRow, numRows, scale, keepDstAlpha);
+            }
+        }
+    });
+}
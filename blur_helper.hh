@@ -0,0 +1,22 @@
+#ifndef BLUR_HELPER_H
+#define BLUR_HELPER_H
+
+/***
+
+    box blur passes for the gaussian blur filter, run directly on interleaved rgba
+
+    a pass blurs along the rows with running sums and writes its result transposed, so two
+    passes in a row blur horizontally and then vertically while only ever reading along rows.
+    rows get done 16 at a time so each write into the transposed image covers a whole cache
+    line, and the strips of rows are split across the thread pool. the strips use SSE2 or
+    AVX2 when the cpu has them (see simd_helper.hh), with the same results as the plain loops.
+
+***/
+
+// box blur every row of src (width x height rgba pixels) over 2 * radius + 1 pixels and write
+// the result into dst transposed, so dst is height x width. pixels past the ends of a row count
+// as copies of the first/last one. if keepDstAlpha is set dst's alpha is left alone, otherwise
+// alpha gets blurred like the other channels
+void boxBlurTransposed(const unsigned char* src, unsigned char* dst, int width, int height, int radius, bool keepDstAlpha);
+
+#endif
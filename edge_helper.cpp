@@ -0,0 +1,237 @@
+#include "edge_helper.hh"
+#include "simd_helper.hh"
+
+#include <cmath>
+#include <cstdlib>
+
+// keep the compiler from fusing the magnitude math into fma instructions (which -march=native
+// allows), so the scalar and vector versions round the same way on every build
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// gx is the vertical smoothing then the horizontal derivative, gy the vertical derivative then the
+// horizontal smoothing. with values up to 255 every sum fits in 16 bits (at most 16 * 3 * 255 for the
+// 5x5 sobel) and gx^2 + gy^2 fits in 32
+struct EdgeKernelTaps {
+    int radius;
+    int smooth[5];
+    int derive[5];
+    float scale; // 3x3 sobel's biggest gradient / this kernel's
+};
+
+static const EdgeKernelTaps edgeKernelTaps[] = {
+    {1, {1, 2, 1}, {-1, 0, 1}, 1.0f},
+    {1, {3, 10, 3}, {-1, 0, 1}, 1.0f / 4},
+    {2, {1, 4, 6, 4, 1}, {-1, -2, 0, 2, 1}, 1.0f / 12},
+};
+
+int getEdgeKernelRadius(EdgeKernel kernel){
+    return edgeKernelTaps[kernel].radius;
+}
+
+/***
+    scalar versions (also used for the pixels left over after the vector loops)
+***/
+static void verticalPassScalar(const int16_t* const* rows, int start, int width, const EdgeKernelTaps& taps, int16_t* smoothed, int16_t* derived){
+    int size = 2 * taps.radius + 1;
+    for(int x = start; x < width; x++){
+        int smooth = 0;
+        int derive = 0;
+        for(int k = 0; k < size; k++){
+            smooth += taps.smooth[k] * rows[k][x];
+            derive += taps.derive[k] * rows[k][x];
+        }
+        smoothed[x] = (int16_t)smooth;
+        derived[x] = (int16_t)derive;
+    }
+}
+
+// magnitudes come out as float and get rounded up like std::ceil would
+static inline unsigned char edgeMagnitudeScalar(int gx, int gy, EdgeMagnitude magnitude, float scale){
+    float value;
+    if(magnitude == EdgeMagnitude::L1Magnitude){
+        value = (float)(std::abs(gx) + std::abs(gy)) * scale;
+    }else{
+        value = std::sqrt((float)(gx * gx + gy * gy)) * scale;
+    }
+    int result = (int)value;
+    if((float)result < value){
+        result++;
+    }
+    return (unsigned char)(result > 255 ? 255 : result);
+}
+
+static void horizontalPassScalar(const int16_t* smoothed, const int16_t* derived, int start, int end, const EdgeKernelTaps& taps, EdgeMagnitude magnitude, unsigned char* out){
+    int size = 2 * taps.radius + 1;
+    for(int x = start; x < end; x++){
+        int gx = 0;
+        int gy = 0;
+        for(int k = 0; k < size; k++){
+            gx += taps.derive[k] * smoothed[x - taps.radius + k];
+            gy += taps.smooth[k] * derived[x - taps.radius + k];
+        }
+        out[x] = edgeMagnitudeScalar(gx, gy, magnitude, taps.scale);
+    }
+}
+
+#if SIMD_X86
+/***
+    SSE2 versions, 8 pixels per iteration in 16-bit lanes
+***/
+__attribute__((target("sse2")))
+static int verticalPassSse2(const int16_t* const* rows, int width, const EdgeKernelTaps& taps, int16_t* smoothed, int16_t* derived){
+    int size = 2 * taps.radius + 1;
+    int x = 0;
+    for(; x + 8 <= width; x += 8){
+        __m128i smooth = _mm_setzero_si128();
+        __m128i derive = _mm_setzero_si128();
+        for(int k = 0; k < size; k++){
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(rows[k] + x));
+            smooth = _mm_add_epi16(smooth, _mm_mullo_epi16(pixels, _mm_set1_epi16((short)taps.smooth[k])));
+            derive = _mm_add_epi16(derive, _mm_mullo_epi16(pixels, _mm_set1_epi16((short)taps.derive[k])));
+        }
+        _mm_storeu_si128((__m128i*)(smoothed + x), smooth);
+        _mm_storeu_si128((__m128i*)(derived + x), derive);
+    }
+    return x;
+}
+
+// round up the 4 floats in value to ints (they're never negative)
+__attribute__((target("sse2")))
+static inline __m128i ceilSse2(__m128 value){
+    __m128i truncated = _mm_cvttps_epi32(value);
+    __m128 below = _mm_cmplt_ps(_mm_cvtepi32_ps(truncated), value);
+    return _mm_sub_epi32(truncated, _mm_castps_si128(below));
+}
+
+// magnitudes of 4 pixels, from their gx and gy interleaved in 16-bit lanes
+__attribute__((target("sse2")))
+static inline __m128i edgeMagnitudeSse2(__m128i gxy, EdgeMagnitude magnitude, __m128 scale){
+    __m128 value;
+    if(magnitude == EdgeMagnitude::L1Magnitude){
+        __m128i absolute = _mm_max_epi16(gxy, _mm_sub_epi16(_mm_setzero_si128(), gxy));
+        value = _mm_cvtepi32_ps(_mm_madd_epi16(absolute, _mm_set1_epi16(1)));
+    }else{
+        value = _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(gxy, gxy)));
+    }
+    return ceilSse2(_mm_mul_ps(value, scale));
+}
+
+__attribute__((target("sse2")))
+static int horizontalPassSse2(const int16_t* smoothed, const int16_t* derived, int start, int end, const EdgeKernelTaps& taps, EdgeMagnitude magnitude, unsigned char* out){
+    int size = 2 * taps.radius + 1;
+    const __m128 scale = _mm_set1_ps(taps.scale);
+    int x = start;
+    for(; x + 8 <= end; x += 8){
+        __m128i gx = _mm_setzero_si128();
+        __m128i gy = _mm_setzero_si128();
+        for(int k = 0; k < size; k++){
+            __m128i smooth = _mm_loadu_si128((const __m128i*)(smoothed + x - taps.radius + k));
+            __m128i derive = _mm_loadu_si128((const __m128i*)(derived + x - taps.radius + k));
+            gx = _mm_add_epi16(gx, _mm_mullo_epi16(smooth, _mm_set1_epi16((short)taps.derive[k])));
+            gy = _mm_add_epi16(gy, _mm_mullo_epi16(derive, _mm_set1_epi16((short)taps.smooth[k])));
+        }
+        __m128i low = edgeMagnitudeSse2(_mm_unpacklo_epi16(gx, gy), magnitude, scale);
+        __m128i high = edgeMagnitudeSse2(_mm_unpackhi_epi16(gx, gy), magnitude, scale);
+        __m128i result = _mm_packs_epi32(low, high);
+        _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(result, result));
+    }
+    return x;
+}
+
+/***
+    AVX2 versions, 16 pixels per iteration
+***/
+__attribute__((target("avx2")))
+static int verticalPassAvx2(const int16_t* const* rows, int width, const EdgeKernelTaps& taps, int16_t* smoothed, int16_t* derived){
+    int size = 2 * taps.radius + 1;
+    int x = 0;
+    for(; x + 16 <= width; x += 16){
+        __m256i smooth = _mm256_setzero_si256();
+        __m256i derive = _mm256_setzero_si256();
+        for(int k = 0; k < size; k++){
+            __m256i pixels = _mm256_loadu_si256((const __m256i*)(rows[k] + x));
+            smooth = _mm256_add_epi16(smooth, _mm256_mullo_epi16(pixels, _mm256_set1_epi16((short)taps.smooth[k])));
+            derive = _mm256_add_epi16(derive, _mm256_mullo_epi16(pixels, _mm256_set1_epi16((short)taps.derive[k])));
+        }
+        _mm256_storeu_si256((__m256i*)(smoothed + x), smooth);
+        _mm256_storeu_si256((__m256i*)(derived + x), derive);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i ceilAvx2(__m256 value){
+    __m256i truncated = _mm256_cvttps_epi32(value);
+    __m256 below = _mm256_cmp_ps(_mm256_cvtepi32_ps(truncated), value, _CMP_LT_OQ);
+    return _mm256_sub_epi32(truncated, _mm256_castps_si256(below));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i edgeMagnitudeAvx2(__m256i gxy, EdgeMagnitude magnitude, __m256 scale){
+    __m256 value;
+    if(magnitude == EdgeMagnitude::L1Magnitude){
+        value = _mm256_cvtepi32_ps(_mm256_madd_epi16(_mm256_abs_epi16(gxy), _mm256_set1_epi16(1)));
+    }else{
+        value = _mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(gxy, gxy)));
+    }
+    return ceilAvx2(_mm256_mul_ps(value, scale));
+}
+
+// unpacking and packing both work within each half, so the pixels end up back in order
+__attribute__((target("avx2")))
+static int horizontalPassAvx2(const int16_t* smoothed, const int16_t* derived, int start, int end, const EdgeKernelTaps& taps, EdgeMagnitude magnitude, unsigned char* out){
+    int size = 2 * taps.radius + 1;
+    const __m256 scale = _mm256_set1_ps(taps.scale);
+    int x = start;
+    for(; x + 16 <= end; x += 16){
+        __m256i gx = _mm256_setzero_si256();
+        __m256i gy = _mm256_setzero_si256();
+        for(int k = 0; k < size; k++){
+            __m256i smooth = _mm256_loadu_si256((const __m256i*)(smoothed + x - taps.radius + k));
+            __m256i derive = _mm256_loadu_si256((const __m256i*)(derived + x - taps.radius + k));
+            gx = _mm256_add_epi16(gx, _mm256_mullo_epi16(smooth, _mm256_set1_epi16((short)taps.derive[k])));
+            gy = _mm256_add_epi16(gy, _mm256_mullo_epi16(derive, _mm256_set1_epi16((short)taps.smooth[k])));
+        }
+        __m256i low = edgeMagnitudeAvx2(_mm256_unpacklo_epi16(gx, gy), magnitude, scale);
+        __m256i high = edgeMagnitudeAvx2(_mm256_unpackhi_epi16(gx, gy), magnitude, scale);
+        __m256i result = _mm256_packs_epi32(low, high);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+        _mm_storeu_si128((__m128i*)(out + x), packed);
+    }
+    return x;
+}
+#endif
+
+void edgeMagnitudeRow(const int16_t* plane, int width, int y, EdgeKernel kernel, EdgeMagnitude magnitude, int16_t* smoothed, int16_t* derived, unsigned char* out){
+    const EdgeKernelTaps& taps = edgeKernelTaps[kernel];
+    const int16_t* rows[5];
+    for(int k = 0; k < 2 * taps.radius + 1; k++){
+        rows[k] = plane + (long long)(y - taps.radius + k) * width;
+    }
+
+    int start = taps.radius;
+    int end = width - taps.radius;
+    int vertical = 0;
+    int horizontal = start;
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            vertical = verticalPassAvx2(rows, width, taps, smoothed, derived);
+            verticalPassScalar(rows, vertical, width, taps, smoothed, derived);
+            horizontal = horizontalPassAvx2(smoothed, derived, start, end, taps, magnitude, out);
+            break;
+        case SimdLevel::Sse2:
+            vertical = verticalPassSse2(rows, width, taps, smoothed, derived);
+            verticalPassScalar(rows, vertical, width, taps, smoothed, derived);
+            horizontal = horizontalPassSse2(smoothed, derived, start, end, taps, magnitude, out);
+            break;
+#endif
+        default:
+            verticalPassScalar(rows, 0, width, taps, smoothed, derived);
+    }
+    horizontalPassScalar(smoothed, derived, horizontal, end, taps, magnitude, out);
+}
@@ -0,0 +1,42 @@
+#ifndef EDGE_HELPER_H
+#define EDGE_HELPER_H
+
+/***
+
+    gradient magnitude for the edge detection filter
+
+    the kernels are separable (a smoothing part and a derivative part), so each row of the
+    output is a vertical pass over the rows around it into two 16-bit rows, then a horizontal
+    pass over those that finds the x and y gradients and their magnitude. both passes use SSE2
+    or AVX2 when the cpu has them (see simd_helper.hh), with the same results as the plain loops.
+
+***/
+#include <cstdint>
+
+enum EdgeKernel {
+    Sobel3,  // 3x3 sobel, what the filter always used
+    Scharr3, // 3x3 scharr, better at telling apart gradient directions
+    Sobel5,  // 5x5 sobel, less sensitive to noise
+};
+
+enum EdgeChannels {
+    RedChannel, // the gradient of the red channel, written to r, g and b
+    Luminance,  // the gradient of the luminance, written to r, g and b
+    PerChannel, // each of r, g and b gets its own gradient
+};
+
+enum EdgeMagnitude {
+    L2Magnitude, // sqrt(gx^2 + gy^2), rounded up
+    L1Magnitude, // |gx| + |gy|, cheaper and a bit stronger on diagonals
+};
+
+// how far the given kernel reaches from the center pixel. pixels closer to the edges of the
+// image than this don't get an output
+int getEdgeKernelRadius(EdgeKernel kernel);
+
+// gradient magnitude of row y of plane (width x height, values 0-255) into out[x] for x from the
+// kernel radius to width - radius - 1, scaled so every kernel has about the 3x3 sobel's range and
+// capped at 255. smoothed and derived are scratch rows of width values
+void edgeMagnitudeRow(const int16_t* plane, int width, int y, EdgeKernel kernel, EdgeMagnitude magnitude, int16_t* smoothed, int16_t* derived, unsigned char* out);
+
+#endif
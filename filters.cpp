@@ -1,6 +1,12 @@
 #include "filters.hh"
 #include "voronoi_helper.hh"
 #include "thinning_helper.hh"
+#include "blur_helper.hh"
+#include "thread_pool.hh"
+#include "simd_helper.hh"
+
+#include <algorithm>
+#include <cstring>
 
 int correctRGB(int channel){
     if(channel > 255){
@@ -16,58 +22,39 @@ bool isValidPixel(int row, int col, int width, int height){
   return row < height && row >= 0 && col < width && col >= 0;
 }
 
-// https://github.com/ratkins/RGBConverter/blob/master/RGBConverter.cpp#L92
-std::vector<float> rgbToHsv(int r, int g, int b){
-  float rf = r / 255.0;
-  float gf = g / 255.0;
-  float bf = b / 255.0;
-  
-  float max = std::max(rf, std::max(gf, bf));
-  float min = std::min(rf, std::min(gf, bf));
-  float delta = max - min;
-  
-  float h = max;
-  float s = max;
-  float v = max;
-  
-  s = (max == 0) ? 0 : (delta / max);
-  
-  if(max == min){
-    h = 0;
-  }else{
-    if(max == rf){
-      h = (gf - bf) / delta + (gf < bf ? 6 : 0);
-    }else if(max == gf){
-      h = (bf - rf) / delta + 2;
-    }else{
-      h = (rf - gf) / delta + 4;
+static const std::pair<Filter, const char*> filterNames[] = {
+    {Filter::Grayscale, "grayscale"},
+    {Filter::Invert, "invert"},
+    {Filter::Dots, "dots"},
+    {Filter::Saturation, "saturate"},
+    {Filter::Outline, "outline"},
+    {Filter::Mosaic, "mosaic"},
+    {Filter::ChannelOffset, "channel_offset"},
+    {Filter::Crt, "crt"},
+    {Filter::Voronoi, "voronoi"},
+    {Filter::Thinning, "thinning"},
+    {Filter::Kuwahara, "kuwahara"},
+    {Filter::Blur, "blur"},
+    {Filter::EdgeDetection, "edge_detection"},
+};
+
+const char* getFilterName(Filter filter){
+    for(auto const& f : filterNames){
+        if(f.first == filter){
+            return f.second;
+        }
     }
-    h /= 6;
-  }
-  
-  std::vector<float> result = {h, s, v};
-  
-  return result;
+    return "unknown";
 }
 
-std::vector<int> getRgb(unsigned char* pixelData, int row, int col, int width, int height){
-  int idx = (4 * width * row) + (4 * col);
-  std::vector<int> rgb = {(int)pixelData[idx], (int)pixelData[idx+1], (int)pixelData[idx+2]};
-  return rgb;
-}
-
-float getStdDev(std::vector<float>& vValues){
-  float sum = 0;
-  float total = 0;
-  int numVals = (int)vValues.size();
-  for(float v : vValues){
-    total += v;
-  }
-  float mean = total / numVals;
-  for(float v : vValues){
-    sum += std::pow(v - mean, 2);
-  }
-  return std::sqrt(sum / numVals);
+bool getFilterByName(const std::string& name, Filter& filter){
+    for(auto const& f : filterNames){
+        if(name == f.second){
+            filter = f.first;
+            return true;
+        }
+    }
+    return false;
 }
 
 void setFilterState(Filter filterToSet, std::map<Filter, bool>& filters){
@@ -87,15 +74,10 @@ void clearFilterState(std::map<Filter, bool>& filters){
 }
 
 void grayscale(unsigned char* pixelData, int pixelDataLen){
-    for(int i = 0; i < pixelDataLen - 4; i+=4){
-        unsigned char r = pixelData[i];
-        unsigned char g = pixelData[i+1];
-        unsigned char b = pixelData[i+2];
-        unsigned char grey = (r+g+b)/3;
-        pixelData[i] = grey;
-        pixelData[i+1] = grey;
-        pixelData[i+2] = grey;
-    }
+    // every pixel but the last one
+    parallelFor(0, pixelDataLen/4 - 1, [=](int start, int end){
+        grayscalePixels(pixelData + start*4, end - start);
+    });
 }
 
 void saturate(unsigned char* pixelData, int pixelDataLen, FilterParameters& params){
@@ -112,136 +94,135 @@ void saturate(unsigned char* pixelData, int pixelDataLen, FilterParameters& para
     float g2 = (1 - saturationVal) * lumG;
     float b2 = (1 - saturationVal) * lumB;
 
-    for(int i = 0; i <= pixelDataLen-4; i += 4){
-        int r = (int)pixelData[i];
-        int g = (int)pixelData[i+1];
-        int b = (int)pixelData[i+2];
-        
-        int newR = (int)(r*r1 + g*g2 + b*b2);
-        int newG = (int)(r*r2 + g*g1 + b*b2);
-        int newB = (int)(r*r2 + g*g2 + b*b1);
-        
-        // ensure value is within range of 0 and 255
-        newR = correctRGB(newR);
-        newG = correctRGB(newG);
-        newB = correctRGB(newB);
-        
-        pixelData[i] = (unsigned char)newR;
-        pixelData[i+1] = (unsigned char)newG;
-        pixelData[i+2] = (unsigned char)newB;
-    }
+    parallelFor(0, pixelDataLen/4, [=](int start, int end){
+        saturatePixels(pixelData + start*4, end - start, r1, g1, b1, r2, g2, b2);
+    });
 }
 
 // for each pixel, check the above pixel (if it exists)
 // if the above pixel is 'significantly' different (i.e. more than +/- 5 of rgb),
 // color the above pixel black and the current pixel white. otherwise, both become white. 
+//
+// since the above pixel is written last, that works out to: a pixel is black if the pixel
+// below it is significantly different, otherwise white. so each row only depends on
+// sourceImageCopy and the rows can be done in any order
 void outline(unsigned char* pixelData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
     int limit = params.outlineLimit;
-    bool setSameColor = false;
-            
-    for(int i = 0; i < imageHeight; i++){
-        for(int j = 0; j < imageWidth; j++){
-            // the current pixel is i*width + j
-            // the above pixel is (i-1)*width + j
-            if(i > 0){
-                int aboveIndexR = (i-1)*imageWidth*4 + j*4;
-                int aboveIndexG = (i-1)*imageWidth*4 + j*4 + 1;
-                int aboveIndexB = (i-1)*imageWidth*4 + j*4 + 2;
-                
-                int currIndexR = i*imageWidth*4 + j*4;
-                int currIndexG = i*imageWidth*4 + j*4 + 1;
-                int currIndexB = i*imageWidth*4 + j*4 + 2;
-                
-                uint8_t aboveR = sourceImageCopy[aboveIndexR];
-                uint8_t aboveG = sourceImageCopy[aboveIndexG];
-                uint8_t aboveB = sourceImageCopy[aboveIndexB];
-            
-                uint8_t currR = sourceImageCopy[currIndexR]; 
-                uint8_t currG = sourceImageCopy[currIndexG];
-                uint8_t currB = sourceImageCopy[currIndexB];
+    
+    // a single row has nothing above or below it, so it's left alone
+    if(imageHeight < 2){
+        return;
+    }
+    
+    parallelFor(0, imageHeight, [=](int startRow, int endRow){
+        for(int i = startRow; i < endRow; i++){
+            for(int j = 0; j < imageWidth; j++){
+                int currIndex = i*imageWidth*4 + j*4;
+                bool setSameColor = true;
                 
-                if(aboveR - currR < limit && aboveR - currR > -limit){
-                    if(aboveG - currG < limit && aboveG - currG > -limit){
-                        if(aboveB - currB < limit && aboveB - currB > -limit){
-                            setSameColor = true;
-                        }else{
+                // the bottom row never has a pixel below it
+                if(i < imageHeight - 1){
+                    int belowIndex = (i+1)*imageWidth*4 + j*4;
+                    for(int k = 0; k < 3; k++){
+                        int diff = sourceImageCopy[currIndex + k] - sourceImageCopy[belowIndex + k];
+                        if(!(diff < limit && diff > -limit)){
                             setSameColor = false;
                         }
-                    }else{
-                        setSameColor = false;
                     }
-                }else{
-                    setSameColor = false;
                 }
                 
-                if(!setSameColor){
-                    pixelData[aboveIndexR] = 0;
-                    pixelData[aboveIndexG] = 0;
-                    pixelData[aboveIndexB] = 0;
-                    
-                    pixelData[currIndexR] = 255; 
-                    pixelData[currIndexG] = 255; 
-                    pixelData[currIndexB] = 255; 
-                }else{
-                    pixelData[aboveIndexR] = 255;
-                    pixelData[aboveIndexG] = 255;
-                    pixelData[aboveIndexB] = 255;
-                    
-                    pixelData[currIndexR] = 255; 
-                    pixelData[currIndexG] = 255; 
-                    pixelData[currIndexB] = 255; 
-                }
+                unsigned char newColor = setSameColor ? 255 : 0;
+                pixelData[currIndex] = newColor;
+                pixelData[currIndex + 1] = newColor;
+                pixelData[currIndex + 2] = newColor;
             }
         }
-    }  
+    });
 }
 
 void invert(unsigned char* pixelData, int pixelDataLen){
-    for(int i = 0; i < pixelDataLen - 4; i+=4){
-        pixelData[i] = 255 - pixelData[i];
-        pixelData[i+1] = 255 - pixelData[i+1];
-        pixelData[i+2] = 255 - pixelData[i+2];
-    }
+    // every pixel but the last one
+    parallelFor(0, pixelDataLen/4 - 1, [=](int start, int end){
+        invertPixels(pixelData + start*4, end - start);
+    });
 }
 
 void channelOffset(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
-    for(int row = 0; row < imageHeight; row++){
-        for(int col = 0; col < imageWidth; col++){
-            int randNum = params.chanOffsetRandNum;
-            int offset = params.chanOffset;
-            if((offset + col) < imageWidth){
-                uint8_t newR = sourceImageCopy[4*imageWidth*row + 4*(col+offset)];
-                uint8_t newG = sourceImageCopy[4*imageWidth*row + 4*(col+offset) + 1];
-                uint8_t newB = sourceImageCopy[4*imageWidth*row + 4*(col+offset) + 2];
-                
-                if(randNum == 0){
-                    imageData[4*imageWidth*row + 4*col] = newR;
-                }else if(randNum == 1){
-                    imageData[4*imageWidth*row + 4*col + 1] = newG;
-                }else{
-                    imageData[4*imageWidth*row + 4*col + 2] = newB;
+    int randNum = params.chanOffsetRandNum;
+    int offset = params.chanOffset;
+    
+    parallelFor(0, imageHeight, [=](int startRow, int endRow){
+        for(int row = startRow; row < endRow; row++){
+            for(int col = 0; col < imageWidth; col++){
+                if((offset + col) < imageWidth){
+                    uint8_t newR = sourceImageCopy[4*imageWidth*row + 4*(col+offset)];
+                    uint8_t newG = sourceImageCopy[4*imageWidth*row + 4*(col+offset) + 1];
+                    uint8_t newB = sourceImageCopy[4*imageWidth*row + 4*(col+offset) + 2];
+                    
+                    if(randNum == 0){
+                        imageData[4*imageWidth*row + 4*col] = newR;
+                    }else if(randNum == 1){
+                        imageData[4*imageWidth*row + 4*col + 1] = newG;
+                    }else{
+                        imageData[4*imageWidth*row + 4*col + 2] = newB;
+                    }
                 }
             }
         }
+    });
+}
+
+// crt only depends on the channel value and whether the row is a scan line, so
+// both cases get worked out for every channel value and reused while brightboost and intensity stay the same
+struct CrtLookupTable {
+    bool valid = false;
+    float brightboost = 0;
+    float intensity = 0;
+    int high[256];
+    int low[256];
+};
+
+static const CrtLookupTable& getCrtLookupTable(float brightboost, float intensity){
+    // one per thread so several images can be filtered at once without locking
+    static thread_local CrtLookupTable table;
+    
+    if(!table.valid || table.brightboost != brightboost || table.intensity != intensity){
+        // run every value through crtPixels so the table matches the per-pixel math exactly
+        unsigned char values[256*4];
+        unsigned char result[256*4];
+        for(int i = 0; i < 256; i++){
+            values[4*i] = values[4*i + 1] = values[4*i + 2] = (unsigned char)i;
+            values[4*i + 3] = 255;
+        }
+        
+        crtPixels(result, values, 256, true, brightboost, intensity);
+        for(int i = 0; i < 256; i++){
+            table.high[i] = result[4*i];
+        }
+        crtPixels(result, values, 256, false, brightboost, intensity);
+        for(int i = 0; i < 256; i++){
+            table.low[i] = result[4*i];
+        }
+        
+        table.brightboost = brightboost;
+        table.intensity = intensity;
+        table.valid = true;
     }
+    
+    return table;
 }
 
 void crt(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
     // adapted from: https://github.com/libretro/glsl-shaders/blob/master/crt/shaders/crt-nes-mini.glsl
-    for(int row = 0; row < imageHeight; row++){
-        for(int col = 0; col < imageWidth; col++){
-            int selectHigh = (params.scanLineThickness > 0 && row % params.scanLineThickness == 0) ? 1 : 0;
-            int selectLow = 1 - selectHigh;
-            
-            for(int i = 0; i < 3; i++){
-                float currChannel = sourceImageCopy[4*imageWidth*row + 4*col + i] / 255.0f;
-                float channelHigh = ((1.0f + params.brightboost) - (0.2f * currChannel)) * currChannel;
-                float channelLow = ((1.0f - params.intensity) + (0.1f * currChannel)) * currChannel;
-                float newColorVal = (selectLow * channelLow) + (selectHigh * channelHigh);
-                imageData[4*imageWidth*row + 4*col + i] = (unsigned char)(255.0f * newColorVal);
-            }
+    int scanLineThickness = params.scanLineThickness;
+    const CrtLookupTable& table = getCrtLookupTable(params.brightboost, params.intensity);
+    
+    parallelFor(0, imageHeight, [=, &table](int startRow, int endRow){
+        for(int row = startRow; row < endRow; row++){
+            bool highLine = scanLineThickness > 0 && row % scanLineThickness == 0;
+            lookupPixels(imageData + 4*imageWidth*row, sourceImageCopy + 4*imageWidth*row, imageWidth, highLine ? table.high : table.low);
         }
-    }
+    });
 }
 
 void mosaic(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
@@ -251,123 +232,207 @@ void mosaic(unsigned char* imageData, unsigned char* sourceImageCopy, int imageW
     int chunkWidth = chunkSize;
     int chunkHeight = chunkSize;
     
+    // each row of chunks only writes to its own rows, so those get split between threads
+    int numChunkRows = (imageHeight + chunkHeight - 1) / chunkHeight;
+    
     // take care of whole chunks in the mosaic that will be chunkWidth x chunkHeight
-    for(int i = 0; i < imageWidth; i += chunkWidth){
-        for(int j = 0; j < imageHeight; j += chunkHeight){
-            // 4*i + 4*j*width = index of first pixel in chunk
-            // get the color of the first pixel in this chunk
-            // multiply by 4 because 4 channels per pixel
-            // multiply by width because all the image data is in a single array and a row is dependent on width
-            uint8_t r = sourceImageCopy[4*i + 4*j*imageWidth];
-            uint8_t g = sourceImageCopy[4*i + 4*j*imageWidth + 1];
-            uint8_t b = sourceImageCopy[4*i + 4*j*imageWidth + 2];
-            
-            // based on the chunk dimensions, there might be partial chunks
-            // for the last chunk in a row, if there's a partial chunk chunkWidth-wise,
-            // include it with this chunk too
-            // do the same of any rows that are unable to have a full chunkHeight chunk
-            int endWidth = (i+chunkWidth) > imageWidth ? (i+imageWidth%chunkWidth) : (i+chunkWidth);
-            int endHeight = (j+chunkHeight) > imageHeight ? (j+imageHeight%chunkHeight) : (j+chunkHeight);
-            
-            // now for all the other pixels in this chunk, set them to this color
-            for(int k = i; k < endWidth; k++){
+    parallelFor(0, numChunkRows, [=](int startChunkRow, int endChunkRow){
+        for(int j = startChunkRow * chunkHeight; j < endChunkRow * chunkHeight; j += chunkHeight){
+            for(int i = 0; i < imageWidth; i += chunkWidth){
+                // 4*i + 4*j*width = index of first pixel in chunk
+                // get the color of the first pixel in this chunk
+                // multiply by 4 because 4 channels per pixel
+                // multiply by width because all the image data is in a single array and a row is dependent on width
+                uint8_t r = sourceImageCopy[4*i + 4*j*imageWidth];
+                uint8_t g = sourceImageCopy[4*i + 4*j*imageWidth + 1];
+                uint8_t b = sourceImageCopy[4*i + 4*j*imageWidth + 2];
+                
+                // based on the chunk dimensions, there might be partial chunks
+                // for the last chunk in a row, if there's a partial chunk chunkWidth-wise,
+                // include it with this chunk too
+                // do the same of any rows that are unable to have a full chunkHeight chunk
+                int endWidth = (i+chunkWidth) > imageWidth ? (i+imageWidth%chunkWidth) : (i+chunkWidth);
+                int endHeight = (j+chunkHeight) > imageHeight ? (j+imageHeight%chunkHeight) : (j+chunkHeight);
+                
+                // now for all the other pixels in this chunk, set them to this color
                 for(int l = j; l < endHeight; l++){
-                    imageData[4*k + 4*l*imageWidth] = r;
-                    imageData[4*k + 4*l*imageWidth + 1] = g;
-                    imageData[4*k + 4*l*imageWidth + 2] = b;
+                    for(int k = i; k < endWidth; k++){
+                        imageData[4*k + 4*l*imageWidth] = r;
+                        imageData[4*k + 4*l*imageWidth + 1] = g;
+                        imageData[4*k + 4*l*imageWidth + 2] = b;
+                    }
                 }
             }
         }
-    }
+    });
+}
+
+// pixels per side of the tiles voronoi() finds candidate neighbors for
+#define VORONOI_TILE_SIZE 16
+
+// color each pixel like its nearest neighbor, mixing in the second nearest one's color within
+// blendWidth pixels of the edge between their cells (half and half right on the edge)
+static void voronoiBlendedEdges(unsigned char* imageData, int lastPixel, int width, int height, const std::vector<CustomPoint>& neighborList, int blendWidth){
+    KdTree tree;
+    build2dTree(tree, neighborList);
+    
+    parallelFor(0, height, [=, &tree](int startRow, int endRow){
+        // one scanline at a time
+        std::vector<int> queryX(width);
+        std::vector<int> queryY(width);
+        std::vector<int> neighbors(2 * width);
+        std::vector<long long> neighborDists(2 * width);
+        for(int x = 0; x < width; x++){
+            queryX[x] = x;
+        }
+        
+        for(int y = startRow; y < endRow; y++){
+            std::fill(queryY.begin(), queryY.end(), y);
+            findNearestNeighbors(tree, queryX.data(), queryY.data(), width, 2, neighbors.data(), neighborDists.data());
+            
+            for(int x = 0; x < width && y*width + x < lastPixel; x++){
+                const CustomPoint& nearest = tree.points[neighbors[2*x]];
+                const CustomPoint& second = neighbors[2*x + 1] >= 0 ? tree.points[neighbors[2*x + 1]] : nearest;
+                
+                float weight = 1.0f; // how much of the nearest neighbor's color to use
+                long long sepX = second.x - nearest.x;
+                long long sepY = second.y - nearest.y;
+                if(sepX != 0 || sepY != 0){
+                    // distance from the pixel to the line halfway between the two neighbors
+                    float edgeDist = (float)(neighborDists[2*x + 1] - neighborDists[2*x]) / (2.0f * std::sqrt((float)(sepX*sepX + sepY*sepY)));
+                    if(edgeDist < blendWidth){
+                        weight = 0.5f + 0.5f * edgeDist / blendWidth;
+                    }
+                }
+                
+                int i = 4 * (y*width + x);
+                imageData[i] = (unsigned char)(nearest.r * weight + second.r * (1.0f - weight) + 0.5f);
+                imageData[i+1] = (unsigned char)(nearest.g * weight + second.g * (1.0f - weight) + 0.5f);
+                imageData[i+2] = (unsigned char)(nearest.b * weight + second.b * (1.0f - weight) + 0.5f);
+            }
+        }
+    });
 }
 
 void voronoi(unsigned char* imageData, int pixelDataLen, int width, int height, FilterParameters& params){
-    int neighborConstant = params.voronoiNeighborCount;
+    int neighborConstant = std::max(1, params.voronoiNeighborCount);
+    
+    // spacing of the neighbors. at least 1 so a neighbor count larger than the image doesn't divide by 0
+    int stepX = std::max(1, width / neighborConstant);
+    int stepY = std::max(1, height / neighborConstant);
+    
+    // the last pixel is left out, like the other filters that skip it
+    int lastPixel = pixelDataLen/4 - 1;
 
     std::vector<CustomPoint> neighborList;
 
-    // get neighbors
-    for(int i = 0; i < pixelDataLen - 4; i+=4){        
-        std::pair<int, int> pxCoords = getPixelCoords(i, width, height);
-        
-        if(pxCoords.first == -1) continue;
-        
-        if(pxCoords.first % (int)std::floor(width / neighborConstant) == 0 && 
-           pxCoords.second % (int)std::floor(height / neighborConstant) == 0 && 
-           pxCoords.first != 0){
+    // get neighbors (every stepX-th pixel of every stepY-th row, except the first column)
+    for(int y = 0; y < height; y += stepY){
+        for(int x = stepX; x < width && y*width + x < lastPixel; x += stepX){
+            int i = 4 * (y*width + x);
+            
             // add some offset to each neighbor for randomness (we don't really want evenly spaced neighbors)
             int offset = rand() % 10;
             int sign = (rand() % 5 + 1) > 5 ? 1 : -1;  // if random num is > 5, positive sign
                
             // larger neighborConstant == more neighbors == more Voronoi shapes
-            int x = (sign * offset) + pxCoords.first;
-            int y = (sign * offset) + pxCoords.second;
-            CustomPoint p1{x, y, imageData[i], imageData[i+1], imageData[i+2]};
+            int nx = (sign * offset) + x;
+            int ny = (sign * offset) + y;
+            CustomPoint p1{nx, ny, imageData[i], imageData[i+1], imageData[i+2]};
             neighborList.push_back(p1);
         }
     }
     
-    // build 2d tree of nearest neighbors 
-    Node* kdtree = build2dTree(neighborList, 0);
+    if(neighborList.empty()){
+        return;
+    }
     
-    for(int i = 0; i < pixelDataLen - 4; i+=4){
-        std::pair<int, int> currCoords = getPixelCoords(i, width, height);
-        
-        if(currCoords.first == -1) continue;
-        
-        CustomPoint nearestNeighbor = findNearestNeighbor(kdtree, currCoords.first, currCoords.second);
-        
-        // found nearest neighbor. color the current pixel the color of the nearest neighbor. 
-        imageData[i] = nearestNeighbor.r;
-        imageData[i+1] = nearestNeighbor.g;
-        imageData[i+2] = nearestNeighbor.b;
+    if(params.voronoiEdgeBlend > 0){
+        voronoiBlendedEdges(imageData, lastPixel, width, height, neighborList, params.voronoiEdgeBlend);
+        return;
     }
     
-    deleteTree(kdtree);
+    // bucket the neighbors into a grid, then work out for each tile of the image which few
+    // neighbors can be the nearest one so each pixel only has to check those
+    SeedGrid grid;
+    buildSeedGrid(grid, neighborList, width, height);
+    
+    int tileSize = VORONOI_TILE_SIZE;
+    int numTileRows = (height + tileSize - 1) / tileSize;
+    
+    parallelFor(0, numTileRows, [=, &grid](int startTileRow, int endTileRow){
+        std::vector<int> candidates;
+        std::vector<int> candidateX;
+        std::vector<int> candidateY;
+        
+        for(int top = startTileRow * tileSize; top < std::min(height, endTileRow * tileSize); top += tileSize){
+            int bottom = std::min(height, top + tileSize);
+            
+            for(int left = 0; left < width; left += tileSize){
+                int right = std::min(width, left + tileSize);
+                
+                findSeedCandidates(grid, left, top, right, bottom, candidates);
+                int numCandidates = (int)candidates.size();
+                candidateX.resize(numCandidates);
+                candidateY.resize(numCandidates);
+                for(int c = 0; c < numCandidates; c++){
+                    candidateX[c] = grid.seeds[candidates[c]].x;
+                    candidateY[c] = grid.seeds[candidates[c]].y;
+                }
+                
+                for(int y = top; y < bottom; y++){
+                    for(int x = left; x < right && y*width + x < lastPixel; x++){
+                        // candidates are in the order they were added, so the first closest one wins ties
+                        int nearest = 0;
+                        long long nearestDist = -1;
+                        for(int c = 0; c < numCandidates; c++){
+                            long long dx = candidateX[c] - x;
+                            long long dy = candidateY[c] - y;
+                            long long dist = dx*dx + dy*dy;
+                            if(nearestDist < 0 || dist < nearestDist){
+                                nearest = c;
+                                nearestDist = dist;
+                            }
+                        }
+                        
+                        // found nearest neighbor. color the current pixel the color of the nearest neighbor. 
+                        const CustomPoint& nearestNeighbor = grid.seeds[candidates[nearest]];
+                        int i = 4 * (y*width + x);
+                        imageData[i] = nearestNeighbor.r;
+                        imageData[i+1] = nearestNeighbor.g;
+                        imageData[i+2] = nearestNeighbor.b;
+                    }
+                }
+            }
+        }
+    });
 }
 
 void thinning(unsigned char* imageData, int pixelDataLen, int width, int height, FilterParameters& params){
     int numIterations = params.thinningIterations;
-    unsigned char* binarized = new unsigned char[pixelDataLen];
-    unsigned char* binarizedCopy = new unsigned char[pixelDataLen];
     float threshold = 0.5;
     
-    while(numIterations > 0){
-        // get a grayscale copy and convert to black/white based on a threshold
-        memcpy(binarized, imageData, pixelDataLen);
-        
-        binarize(binarized, width, height, threshold);
-        
-        memcpy(binarizedCopy, binarized, pixelDataLen);
-        
-        for(int i = 0; i < height; i++){
-            for(int j = 0; j < width; j++){
-                if(
-                    isBlackPixel(binarized, i, j, width) &&
-                    checkBlackNeighbors(binarized, pixelDataLen, i, j, width) &&
-                    testConnectivity(binarized, pixelDataLen, i, j, width) &&
-                    verticalLineCheck(binarized, pixelDataLen, i, j, width) &&
-                    horizontalLineCheck(binarized, pixelDataLen, i, j, width)
-                ){
-                    // this pixel should be erased
-                    binarizedCopy[(4 * width * i) + (4 * j)] = 255;
-                    binarizedCopy[(4 * width * i) + (4 * j) + 1] = 255;
-                    binarizedCopy[(4 * width * i) + (4 * j) + 2] = 255;
-                }
-            }
-        }
-     
-        for(int i = 0; i < pixelDataLen; i++){
-            imageData[i] = binarizedCopy[i];
-        }
-        
+    params.thinningIterationsDone = 0;
+    if(numIterations <= 0){
+        return;
+    }
+    
+    // get a black/white copy based on a threshold, packed 1 bit per pixel.
+    // after the first pass the image is black/white already, so it only needs doing once
+    ThinningBitmap bitmap;
+    packBinarized(bitmap, imageData, pixelDataLen / 4, width, threshold);
+    
+    // stop early once a pass doesn't erase anything, since the rest wouldn't either
+    int (*pass)(ThinningBitmap&) = params.thinningMethod == ThinningMethod::ZhangSuen ? zhangSuenPass : thinningPass;
+    while(numIterations > 0 && pass(bitmap) > 0){
+        params.thinningIterationsDone++;
         numIterations--;
     }
     
-    delete[] binarized;
-    delete[] binarizedCopy;
+    unpackBinarized(bitmap, imageData);
 }
 
+#if !HEADLESS_BUILD
 // trying something like https://github.com/syncopika/funSketch/blob/master/src/filters/dots.js
 // https://discourse.libsdl.org/t/draw-sprites-off-screen/26747/4
 // https://discourse.libsdl.org/t/i-have-rendered-using-sdl-renderdrawpoint-my-figure-keeps-redrawing-itself-i-want-it-to-stop-refreshing/33283/6
@@ -421,124 +486,166 @@ void dots(unsigned char* pixelData, int pixelDataLen, int imageWidth, int imageH
     SDL_DestroyTexture(target);
     SDL_SetRenderTarget(renderer, nullptr);
 }
+#endif
 
 /*** 
   Kuwahara filter 
   https://github.com/syncopika/funSketch/blob/master/src/filters/kuwahara_painting.js
 ***/
-void kuwahara_helper(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height, int row, int col, FilterParameters& params){
-  int pixelIdx = (4 * width * row) + (4 * col);
-  // for this pixel:
-  // get 4 quadrants
-  // get std dev of each quad of the V value in HSV
-  // get quad with smallest std dev
-  // the curr pixel gets the avg of the quad
-  
-  int factor = 3; // TODO: make this a param
-  
-  // top left quad
-  std::vector<float> topLeftV;
-  std::vector<float> topLeftRgb = {0, 0, 0};
-  for(int i = row - factor; i < row; i++){
-    for(int j = col - factor; j < col; j++){
-      if(isValidPixel(i, j, width, height)){
-        std::vector<int> rgb = getRgb(sourceImageCopy, i, j, width, height);
-        std::vector<float> hsv = rgbToHsv(rgb[0], rgb[1], rgb[2]);
-        topLeftV.push_back(hsv[2]);
-        topLeftRgb[0] += (float)rgb[0];
-        topLeftRgb[1] += (float)rgb[1];
-        topLeftRgb[2] += (float)rgb[2];
-      }
-    }
+// quadrant sums are 32-bit, see KuwaharaSums
+#define KUWAHARA_MAX_FACTOR 256
+
+// running sums for one entry of a summed-area table. these are unsigned and allowed to wrap around:
+// a quadrant's sum is still exact as long as it fits in 32 bits, which it does for factors up to 256
+struct KuwaharaSums {
+  uint32_t r;
+  uint32_t g;
+  uint32_t b;
+  uint32_t v;  // v = max(r, g, b), the V in HSV scaled to 0-255
+  uint32_t v2; // v squared
+};
+
+struct KuwaharaQuadrant {
+  uint32_t count;
+  KuwaharaSums sums;
+};
+
+// sums over rows [top, bottom) and cols [left, right) of a table with (width + 1) entries per row
+static inline KuwaharaQuadrant getQuadrant(const KuwaharaSums* table, int tableWidth, int top, int bottom, int left, int right){
+  KuwaharaQuadrant quad;
+  quad.count = (bottom > top && right > left) ? (uint32_t)((bottom - top) * (right - left)) : 0;
+  if(quad.count == 0){
+    return quad;
   }
-  float topLeftStdDev = getStdDev(topLeftV);
   
-  // top right quad
-  std::vector<float> topRightV;
-  std::vector<float> topRightRgb = {0, 0, 0};
-  for(int i = row - factor; i < row; i++){
-    for(int j = col; j < (col + factor); j++){
-      if(isValidPixel(i, j, width, height)){
-        std::vector<int> rgb = getRgb(sourceImageCopy, i, j, width, height);
-        std::vector<float> hsv = rgbToHsv(rgb[0], rgb[1], rgb[2]);
-        topRightV.push_back(hsv[2]);
-        topRightRgb[0] += (float)rgb[0];
-        topRightRgb[1] += (float)rgb[1];
-        topRightRgb[2] += (float)rgb[2];
-      }
-    }
-  }
-  float topRightStdDev = getStdDev(topRightV);
-  
-  // bottom left quad
-  std::vector<float> bottomLeftV;
-  std::vector<float> bottomLeftRgb = {0, 0, 0};
-  for(int i = row; i < row + factor; i++){
-    for(int j = col - factor; j < col; j++){
-      if(isValidPixel(i, j, width, height)){
-        std::vector<int> rgb = getRgb(sourceImageCopy, i, j, width, height);
-        std::vector<float> hsv = rgbToHsv(rgb[0], rgb[1], rgb[2]);
-        bottomLeftV.push_back(hsv[2]);
-        bottomLeftRgb[0] += (float)rgb[0];
-        bottomLeftRgb[1] += (float)rgb[1];
-        bottomLeftRgb[2] += (float)rgb[2];
-      }
-    }
+  const KuwaharaSums& a = table[top * tableWidth + left];
+  const KuwaharaSums& b = table[top * tableWidth + right];
+  const KuwaharaSums& c = table[bottom * tableWidth + left];
+  const KuwaharaSums& d = table[bottom * tableWidth + right];
+  quad.sums.r = d.r - b.r - c.r + a.r;
+  quad.sums.g = d.g - b.g - c.g + a.g;
+  quad.sums.b = d.b - b.b - c.b + a.b;
+  quad.sums.v = d.v - b.v - c.v + a.v;
+  quad.sums.v2 = d.v2 - b.v2 - c.v2 + a.v2;
+  return quad;
+}
+
+// n^2 * variance of v, which is exact in integers
+static inline int64_t getScaledVariance(const KuwaharaQuadrant& quad){
+  return (int64_t)quad.count * quad.sums.v2 - (int64_t)quad.sums.v * quad.sums.v;
+}
+
+// true if quad a has a smaller std dev than quad b. empty quadrants never win
+static inline bool hasSmallerVariance(const KuwaharaQuadrant& a, const KuwaharaQuadrant& b){
+  if(a.count == 0){
+    return false;
   }
-  float bottomLeftStdDev = getStdDev(bottomLeftV);
-  
-  // bottom right quad
-  std::vector<float> bottomRightV;
-  std::vector<float> bottomRightRgb = {0, 0, 0};
-  for(int i = row; i > 0 && i < height && i < row + factor; i++){
-    for(int j = col; j > 0 && j < (col + factor); j++){
-      if(isValidPixel(i, j, width, height)){
-        std::vector<int> rgb = getRgb(sourceImageCopy, i, j, width, height);
-        std::vector<float> hsv = rgbToHsv(rgb[0], rgb[1], rgb[2]);
-        bottomRightV.push_back(hsv[2]);
-        bottomRightRgb[0] += (float)rgb[0];
-        bottomRightRgb[1] += (float)rgb[1];
-        bottomRightRgb[2] += (float)rgb[2];
-      }
-    }
+  if(b.count == 0){
+    return true;
   }
-  float bottomRightStdDev = getStdDev(bottomRightV);
-  
-  // assign avg color of smallest std dev quadrant
-  float minStdDev = std::min(topLeftStdDev, std::min(topRightStdDev, std::min(bottomRightStdDev, bottomLeftStdDev)));
-  if(minStdDev == topLeftStdDev){
-    imageData[pixelIdx] =     (unsigned char)(topLeftRgb[0] / (float)topLeftV.size());
-    imageData[pixelIdx + 1] = (unsigned char)(topLeftRgb[1] / (float)topLeftV.size());
-    imageData[pixelIdx + 2] = (unsigned char)(topLeftRgb[2] / (float)topLeftV.size());
-  }else if(minStdDev == topRightStdDev){
-    imageData[pixelIdx] =     (unsigned char)(topRightRgb[0] / (float)topRightV.size());
-    imageData[pixelIdx + 1] = (unsigned char)(topRightRgb[1] / (float)topRightV.size());
-    imageData[pixelIdx + 2] = (unsigned char)(topRightRgb[2] / (float)topRightV.size());
-  }else if(minStdDev == bottomLeftStdDev){
-    imageData[pixelIdx] =     (unsigned char)(bottomLeftRgb[0] / (float)bottomLeftV.size());
-    imageData[pixelIdx + 1] = (unsigned char)(bottomLeftRgb[1] / (float)bottomLeftV.size());
-    imageData[pixelIdx + 2] = (unsigned char)(bottomLeftRgb[2] / (float)bottomLeftV.size());
-  }else{
-    imageData[pixelIdx] =     (unsigned char)(bottomRightRgb[0] / (float)bottomRightV.size());
-    imageData[pixelIdx + 1] = (unsigned char)(bottomRightRgb[1] / (float)bottomRightV.size());
-    imageData[pixelIdx + 2] = (unsigned char)(bottomRightRgb[2] / (float)bottomRightV.size());
+  if(a.count == b.count){
+    // same size (every quadrant away from the edges), so the scaled variances compare exactly
+    return getScaledVariance(a) < getScaledVariance(b);
   }
+  return (double)getScaledVariance(a) / ((double)a.count * a.count) < (double)getScaledVariance(b) / ((double)b.count * b.count);
 }
 
+// every pixel gets the average color of whichever of its 4 quadrants (factor x factor, clipped to the image)
+// has the smallest std dev of V. the quadrant sums come from summed-area tables built for a band of rows
+// at a time, so the cost per pixel doesn't depend on the factor.
+//
+// differences from the original per-pixel version (see the link above): ties between quadrants are
+// decided with exact integer math, quadrants that fall entirely outside the image are skipped (instead
+// of turning the pixel into nan), and the bottom right quadrant is used on the first row and column too
 void kuwahara(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
-  for(int i = 0; i < imageHeight; i++){
-    for(int j = 0; j < imageWidth; j++){
-      kuwahara_helper(imageData, sourceImageCopy, imageWidth, imageHeight, i, j, params);
+  int factor = std::max(1, std::min(params.kuwaharaFactor, KUWAHARA_MAX_FACTOR));
+  int tableWidth = imageWidth + 1;
+  
+  // rows of output per table. larger factors need more rows above and below each band,
+  // so the band grows with the factor to keep that overhead down
+  int bandRows = std::max(64, 4 * factor);
+  
+  parallelFor(0, imageHeight, [=](int startRow, int endRow){
+    std::vector<KuwaharaSums> table;
+    
+    for(int bandStart = startRow; bandStart < endRow; bandStart += bandRows){
+      int bandEnd = std::min(bandStart + bandRows, endRow);
+      
+      // source rows the quadrants of this band can reach
+      int firstRow = std::max(0, bandStart - factor);
+      int lastRow = std::min(imageHeight, bandEnd + factor);
+      int tableRows = lastRow - firstRow + 1;
+      
+      // table[y][x] = sums over source rows [firstRow, firstRow + y) and cols [0, x)
+      table.assign(tableRows * tableWidth, KuwaharaSums{0, 0, 0, 0, 0});
+      for(int y = 1; y < tableRows; y++){
+        const unsigned char* src = sourceImageCopy + 4 * imageWidth * (firstRow + y - 1);
+        const KuwaharaSums* above = &table[(y - 1) * tableWidth];
+        KuwaharaSums* curr = &table[y * tableWidth];
+        KuwaharaSums rowSums{0, 0, 0, 0, 0};
+        
+        for(int x = 1; x < tableWidth; x++){
+          uint32_t r = src[4 * (x - 1)];
+          uint32_t g = src[4 * (x - 1) + 1];
+          uint32_t b = src[4 * (x - 1) + 2];
+          uint32_t v = std::max(r, std::max(g, b));
+          
+          rowSums.r += r;
+          rowSums.g += g;
+          rowSums.b += b;
+          rowSums.v += v;
+          rowSums.v2 += v * v;
+          
+          curr[x].r = above[x].r + rowSums.r;
+          curr[x].g = above[x].g + rowSums.g;
+          curr[x].b = above[x].b + rowSums.b;
+          curr[x].v = above[x].v + rowSums.v;
+          curr[x].v2 = above[x].v2 + rowSums.v2;
+        }
+      }
+      
+      for(int row = bandStart; row < bandEnd; row++){
+        // in table coordinates
+        int top = std::max(0, row - factor) - firstRow;
+        int middle = row - firstRow;
+        int bottom = std::min(imageHeight, row + factor) - firstRow;
+        
+        for(int col = 0; col < imageWidth; col++){
+          int left = std::max(0, col - factor);
+          int right = std::min(imageWidth, col + factor);
+          
+          // in the order ties are broken in: the first quadrant with the smallest std dev wins
+          KuwaharaQuadrant quads[4] = {
+            getQuadrant(table.data(), tableWidth, top, middle, left, col),     // top left
+            getQuadrant(table.data(), tableWidth, top, middle, col, right),    // top right
+            getQuadrant(table.data(), tableWidth, middle, bottom, left, col),  // bottom left
+            getQuadrant(table.data(), tableWidth, middle, bottom, col, right), // bottom right (always has this pixel)
+          };
+          
+          int best = 3;
+          for(int q = 2; q >= 0; q--){
+            if(!hasSmallerVariance(quads[best], quads[q])){
+              best = q;
+            }
+          }
+          
+          const KuwaharaQuadrant& quad = quads[best];
+          int pixelIdx = (4 * imageWidth * row) + (4 * col);
+          imageData[pixelIdx] = (unsigned char)(quad.sums.r / quad.count);
+          imageData[pixelIdx + 1] = (unsigned char)(quad.sums.g / quad.count);
+          imageData[pixelIdx + 2] = (unsigned char)(quad.sums.b / quad.count);
+        }
+      }
     }
-  }
+  });
 }
 
 /*** 
   Gaussian blur filter 
   https://github.com/syncopika/funSketch/blob/master/src/filters/blur.js
   
-  TODO: this filter is still buggy and I get weird color artifacts
-  could it be a numerical precision issue?
+  approximated with three box blurs (see blur_helper.hh). the box passes keep integer sums and
+  round each pixel exactly, so every cpu and simd level gives the same result
 ***/
 std::vector<int> generateGaussBoxes(float stdDev, int numBoxes){
   float wIdeal = std::sqrt((12 * stdDev * stdDev / numBoxes) + 1); // ideal averaging filter width
@@ -562,156 +669,132 @@ std::vector<int> generateGaussBoxes(float stdDev, int numBoxes){
   return sizes;
 }
 
-void boxBlurHorz(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev){
-  float iarr = 1.0 / (stdDev + stdDev + 1.0);
-  for(int i = 0; i < height; i++){
-    int ti = i * width;
-    int li = ti;
-    int ri = ti + stdDev;
-          
-    int fv = src[ti];
-    int lv = src[ti + width - 1];
-    float val = (stdDev + 1) * fv;
-    
-    for(int j = 0; j < stdDev; j++){
-      val += src[ti + j];
-    }
-          
-    for(int j = 0; j <= stdDev; j++){
-      val += src[ri++] - fv;
-      trgt[ti++] = std::round(val * iarr);
-    }
-          
-    for(int j = stdDev + 1; j < width - stdDev; j++){
-      val += src[ri++] - src[li++];
-      trgt[ti++] = std::round(val * iarr);
-    }
-          
-    for(int j = width - stdDev; j < width; j++){
-      val += lv - src[li++];
-      trgt[ti++] = std::round(val * iarr);
-    }
-  }
-}
-
-void boxBlurTotal(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev){
-  float iarr = 1.0 / (stdDev + stdDev + 1.0);
-  for(int i = 0; i < width; i++){
-    int ti = i;
-    int li = ti;
-    int ri = ti + stdDev * width;
-          
-    int fv = src[ti];
-    int lv = src[ti + width * (height - 1)];
-    float val = (stdDev + 1) * fv;
-          
-    for(int j = 0; j < stdDev; j++){
-      val += src[ti + j * width];
-    }
-          
-    for(int j = 0; j <= stdDev; j++){
-      val += src[ri] - fv;
-      trgt[ti] = std::round(val * iarr);
-      ri += width;
-      ti += width;
-    }
-          
-    for(int j = stdDev + 1; j < height - stdDev; j++){
-      val += src[ri] - src[li];
-      trgt[ti] = std::round(val * iarr);
-      li += width;
-      ri += width;
-      ti += width;
-    }
-          
-    for(int j = height - stdDev; j < height; j++){
-      val += lv - src[li];
-      trgt[ti] = std::round(val * iarr);
-      li += width;
-      ti += width;
-    }
-  }
-}
-
-void boxBlur(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev){
-  for(int i = 0; i < (int)src.size(); i++){
-    trgt[i] = src[i];
-  }
-  boxBlurHorz(trgt, src, width, height, stdDev);
-  boxBlurTotal(src, trgt, width, height, stdDev);
-}
-
-void gaussBlur(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev){
-  std::vector<int> boxes = generateGaussBoxes(stdDev, 3);
-  boxBlur(src, trgt, width, height, (boxes[0] - 1.0) / 2.0);
-  boxBlur(trgt, src, width, height, (boxes[1] - 1.0) / 2.0);
-  boxBlur(src, trgt, width, height, (boxes[2] - 1.0) / 2.0);
-}
-
 void blur(unsigned char* imageData, int imageWidth, int imageHeight, FilterParameters& params){
-  int dataLength = 4 * imageWidth * imageHeight;
-  int numPixels = imageWidth * imageHeight;
-  
-  std::vector<int> redChannel(numPixels);
-  std::vector<int> greenChannel(numPixels);
-  std::vector<int> blueChannel(numPixels);
-  
-  for(int i = 0; i <= dataLength - 4; i += 4){
-    redChannel[i/4] = (int)imageData[i];
-    greenChannel[i/4] = (int)imageData[i + 1];
-    blueChannel[i/4] = (int)imageData[i + 2];
-  }
-  
-  float blurFactor = (float)params.blurFactor;
+  size_t dataLength = 4 * (size_t)imageWidth * imageHeight;
   
-  gaussBlur(redChannel, redChannel, imageWidth, imageHeight, blurFactor);
-  gaussBlur(greenChannel, greenChannel, imageWidth, imageHeight, blurFactor);
-  gaussBlur(blueChannel, blueChannel, imageWidth, imageHeight, blurFactor);
+  // each box blur is a horizontal pass into the transposed buffer and then a "horizontal" pass over
+  // that back into the right orientation, which blurs vertically without walking down the columns
+  std::vector<unsigned char> transposed(dataLength);
+  std::vector<unsigned char> blurred(dataLength);
+  std::vector<int> boxes = generateGaussBoxes((float)params.blurFactor, 3);
   
-  for(int i = 0; i <= dataLength - 4; i += 4){
-    imageData[i] = (unsigned char)correctRGB(redChannel[i/4]);
-    imageData[i + 1] = (unsigned char)correctRGB(greenChannel[i/4]);
-    imageData[i + 2] = (unsigned char)correctRGB(blueChannel[i/4]);
+  for(int i = 0; i < 3; i++){
+    int radius = (boxes[i] - 1) / 2;
+    bool last = (i == 2);
+    boxBlurTransposed(i == 0 ? imageData : blurred.data(), transposed.data(), imageWidth, imageHeight, radius, false);
+    boxBlurTransposed(transposed.data(), last ? imageData : blurred.data(), imageHeight, imageWidth, radius, last);
   }
 }
 
 /*** 
   edge detection filter 
   https://github.com/syncopika/funSketch/blob/master/src/filters/edgedetection.js
+  
+  the gradient math is in edge_helper.hh
 ***/
-void edgeDetection(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height){
-  int xKernel[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-  int yKernel[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+void edgeDetection(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height, FilterParameters& params){
+  EdgeKernel kernel = (params.edgeKernel >= EdgeKernel::Sobel3 && params.edgeKernel <= EdgeKernel::Sobel5) ?
+    static_cast<EdgeKernel>(params.edgeKernel) : EdgeKernel::Sobel3;
+  EdgeMagnitude magnitude = (params.edgeMagnitude == EdgeMagnitude::L1Magnitude) ? EdgeMagnitude::L1Magnitude : EdgeMagnitude::L2Magnitude;
+  int radius = getEdgeKernelRadius(kernel);
+  if(width <= 2 * radius || height <= 2 * radius){
+    return;
+  }
+  
+  // 16-bit copies of what the gradient gets taken of: the red channel or the luminance,
+  // or one plane each for r, g and b
+  int numPlanes = (params.edgeChannels == EdgeChannels::PerChannel) ? 3 : 1;
+  size_t numPixels = (size_t)width * height;
+  std::vector<int16_t> planes(numPlanes * numPixels);
+  int16_t* planeData = planes.data();
+  int edgeChannels = params.edgeChannels;
+  
+  parallelFor(0, height, [=](int startRow, int endRow){
+    size_t first = (size_t)startRow * width;
+    size_t last = (size_t)endRow * width;
+    if(edgeChannels == EdgeChannels::PerChannel){
+      for(size_t i = first; i < last; i++){
+        planeData[i] = sourceImageCopy[4 * i];
+        planeData[numPixels + i] = sourceImageCopy[4 * i + 1];
+        planeData[2 * numPixels + i] = sourceImageCopy[4 * i + 2];
+      }
+    }else if(edgeChannels == EdgeChannels::Luminance){
+      // 0.3r + 0.59g + 0.11b in 8-bit fixed point
+      for(size_t i = first; i < last; i++){
+        const unsigned char* pixel = sourceImageCopy + 4 * i;
+        planeData[i] = (int16_t)((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+      }
+    }else{
+      for(size_t i = first; i < last; i++){
+        planeData[i] = sourceImageCopy[4 * i];
+      }
+    }
+  });
+  
+  // pixels closer to the edges than the kernel reaches are left as they are
+  parallelFor(radius, height - radius, [=](int startRow, int endRow){
+    std::vector<int16_t> smoothed(width);
+    std::vector<int16_t> derived(width);
+    std::vector<unsigned char> magnitudes(numPlanes * width);
+    
+    for(int y = startRow; y < endRow; y++){
+      for(int p = 0; p < numPlanes; p++){
+        edgeMagnitudeRow(planeData + p * numPixels, width, y, kernel, magnitude, smoothed.data(), derived.data(), magnitudes.data() + p * width);
+      }
       
-  for(int i = 1; i < height - 1; i++){
-    for(int j = 4; j < 4 * width - 4; j += 4){
-      int left = (4 * i * width) + (j - 4);
-      int right = (4 * i * width) + (j + 4);
-      int top = (4 * (i - 1) * width) + j;
-      int bottom = (4 * (i + 1) * width) + j;
-      int topLeft = (4 * (i - 1) * width) + (j - 4);
-      int topRight = (4 * (i - 1) * width) + (j + 4);
-      int bottomLeft = (4 * (i + 1) * width) + (j - 4);
-      int bottomRight = (4 * (i + 1) * width) + (j + 4);
-      int center = (4 * width * i) + j;
-              
-      // use the xKernel to detect edges horizontally 
-      int pX = (xKernel[0][0] * sourceImageCopy[topLeft]) + (xKernel[0][1] * sourceImageCopy[top]) + (xKernel[0][2] * sourceImageCopy[topRight]) +
-                  (xKernel[1][0] * sourceImageCopy[left]) + (xKernel[1][1] * sourceImageCopy[center]) + (xKernel[1][2] * sourceImageCopy[right]) +
-                  (xKernel[2][0] * sourceImageCopy[bottomLeft]) + (xKernel[2][1] * sourceImageCopy[bottom]) + (xKernel[2][2] * sourceImageCopy[bottomRight]);
-                  
-      // use the yKernel to detect edges vertically 
-      int pY = (yKernel[0][0] * sourceImageCopy[topLeft]) + (yKernel[0][1] * sourceImageCopy[top]) + (yKernel[0][2] * sourceImageCopy[topRight]) +
-                  (yKernel[1][0] * sourceImageCopy[left]) + (yKernel[1][1] * sourceImageCopy[center]) + (yKernel[1][2] * sourceImageCopy[right]) +
-                  (yKernel[2][0] * sourceImageCopy[bottomLeft]) + (yKernel[2][1] * sourceImageCopy[bottom]) + (yKernel[2][2] * sourceImageCopy[bottomRight]);
-              
-      // finally set the current pixel to the new value based on the formula 
-      int newVal = (std::ceil(std::sqrt((pX * pX) + (pY * pY))));
-      imageData[center] = newVal;
-      imageData[center + 1] = newVal;
-      imageData[center + 2] = newVal;
+      unsigned char* row = imageData + 4 * (size_t)y * width;
+      for(int x = radius; x < width - radius; x++){
+        for(int c = 0; c < 3; c++){
+          row[4 * x + c] = magnitudes[(numPlanes == 3 ? c * width : 0) + x];
+        }
+      }
     }
-  }
+  });
 }
 
-
+bool applyFilter(Filter filter, unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params){
+    int pixelDataLen = imageWidth * imageHeight * 4;
+    
+    switch(filter){
+        case Filter::Grayscale:
+            grayscale(imageData, pixelDataLen);
+            break;
+        case Filter::Invert:
+            invert(imageData, pixelDataLen);
+            break;
+        case Filter::Saturation:
+            saturate(imageData, pixelDataLen, params);
+            break;
+        case Filter::Outline:
+            outline(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        case Filter::Mosaic:
+            mosaic(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        case Filter::ChannelOffset:
+            channelOffset(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        case Filter::Crt:
+            crt(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        case Filter::Voronoi:
+            voronoi(imageData, pixelDataLen, imageWidth, imageHeight, params);
+            break;
+        case Filter::Thinning:
+            thinning(imageData, pixelDataLen, imageWidth, imageHeight, params);
+            break;
+        case Filter::Kuwahara:
+            kuwahara(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        case Filter::Blur:
+            blur(imageData, imageWidth, imageHeight, params);
+            break;
+        case Filter::EdgeDetection:
+            edgeDetection(imageData, sourceImageCopy, imageWidth, imageHeight, params);
+            break;
+        default:
+            return false;
+    }
+    
+    return true;
+}
\ No newline at end of file
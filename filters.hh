@@ -3,12 +3,25 @@
 
 #include <iostream>
 #include <map>
+#include <string>
 #include <utility>
 #include <vector>
-#include <SDL.h>
 #include <stdint.h> // for uint8_t
 #include <stdlib.h> // for rand()
 
+#include "edge_helper.hh" // for the edge detection parameters
+
+// HEADLESS_BUILD is for tools that don't link SDL (e.g. image_editor_cli),
+// so any filter that needs an SDL_Renderer is left out
+#if !HEADLESS_BUILD
+#include <SDL.h>
+#endif
+
+enum ThinningMethod {
+    Hilditch,  // one pass at a time, each pixel tested against the image as it was before the pass
+    ZhangSuen, // two subiterations per pass, which split across threads
+};
+
 struct FilterParameters {
     // for saturation
     float lumG = 0.5f;
@@ -33,9 +46,12 @@ struct FilterParameters {
     
     // for Voronoi
     int voronoiNeighborCount = 30;
+    int voronoiEdgeBlend = 0; // pixels on each side of the cell edges to blend over (0 = hard edges)
     
-    // for Hilditch thinning
+    // for thinning
     int thinningIterations = 1;
+    int thinningMethod = ThinningMethod::Hilditch;
+    int thinningIterationsDone = 0; // set by thinning(): how many iterations erased something
     
     void generateRandNum3(){
         chanOffsetRandNum = rand() % 3;
@@ -43,6 +59,14 @@ struct FilterParameters {
     
     // for blur
     int blurFactor = 3;
+    
+    // for Kuwahara (width and height of each quadrant, up to 256)
+    int kuwaharaFactor = 3;
+    
+    // for edge detection
+    int edgeKernel = EdgeKernel::Sobel3;
+    int edgeChannels = EdgeChannels::RedChannel;
+    int edgeMagnitude = EdgeMagnitude::L2Magnitude;
 };
 
 enum Filter {
@@ -63,9 +87,10 @@ enum Filter {
 
 int correctRGB(int channel);
 bool isValidPixel(int row, int col, int width, int height);
-std::vector<float> rgbToHsv(int r, int g, int b);
-std::vector<int> getRgb(unsigned char* pixelData, int row, int col, int width, int height);
-float getStdDev(std::vector<float>& vValues);
+
+// lowercase names for the filters (e.g. "edge_detection"), used by the command line tools
+const char* getFilterName(Filter filter);
+bool getFilterByName(const std::string& name, Filter& filter);
 
 void setFilterState(Filter filterToSet, std::map<Filter, bool>& filters);
 void clearFilterState(std::map<Filter, bool>& filters);
@@ -79,19 +104,21 @@ void channelOffset(unsigned char* imageData, unsigned char* sourceImageCopy, int
 void crt(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params);
 void voronoi(unsigned char* imageData, int pixelDataLen, int width, int height, FilterParameters& params);
 void thinning(unsigned char* imageData, int pixelDataLen, int width, int height, FilterParameters& params);
+#if !HEADLESS_BUILD
 void dots(unsigned char* pixelData, int pixelDataLen, int imageWidth, int imageHeight, SDL_Renderer* renderer);
-void edgeDetection(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height);
+#endif
+void edgeDetection(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height, FilterParameters& params);
 
 // Kuwahara filter
-void kuwahara_helper(unsigned char* imageData, unsigned char* sourceImageCopy, int width, int height, int row, int col, FilterParameters& params);
 void kuwahara(unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params);
 
 // Gaussian blur filter
 std::vector<int> generateGaussBoxes(float stdDev, int numBoxes);
-void boxBlurHorz(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev);
-void boxBlurTotal(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev);
-void boxBlur(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev);
-void gaussBlur(std::vector<int>& src, std::vector<int>& trgt, int width, int height, float stdDev);
 void blur(unsigned char* imageData, int imageWidth, int imageHeight, FilterParameters& params);
 
+// run a filter on imageData, where sourceImageCopy holds an untouched copy of imageData
+// for the filters that need to read the original pixels.
+// returns false if the filter can't be run this way (e.g. dots, which needs a renderer)
+bool applyFilter(Filter filter, unsigned char* imageData, unsigned char* sourceImageCopy, int imageWidth, int imageHeight, FilterParameters& params);
+
 #endif
\ No newline at end of file
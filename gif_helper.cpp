@@ -0,0 +1,898 @@
+#include "gif_helper.hh"
+#include "simd_helper.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+// memory for the most recently used decoded frames (at least 2 get kept whatever their size)
+#define GIF_CACHE_BYTES (64 << 20)
+
+// memory for keyframes. long gifs get their keyframes spread further apart to stay under this
+#define GIF_KEYFRAME_BYTES (64 << 20)
+#define GIF_MIN_KEYFRAME_INTERVAL 8
+
+// decoded frames in between keyframes stop getting stored once the store takes this much memory
+#define GIF_STORE_BYTES (256 << 20)
+
+// edited frames can't be decoded again so they're always kept, with keyframes this often
+#define GIF_EDIT_KEYFRAME_INTERVAL 16
+
+// rows of an interlaced frame come in 4 passes: every 8th row from row 0, every 8th from row 4,
+// every 4th from row 2 and every 2nd from row 1
+static const int interlaceStart[] = {0, 4, 2, 1};
+static const int interlaceStep[] = {8, 8, 4, 2};
+
+// the smallest rectangle holding both a and b
+static GifRect unionRect(const GifRect& a, const GifRect& b){
+    if(a.width == 0 || a.height == 0){
+        return b;
+    }
+    if(b.width == 0 || b.height == 0){
+        return a;
+    }
+    GifRect rect;
+    rect.left = std::min(a.left, b.left);
+    rect.top = std::min(a.top, b.top);
+    rect.width = std::max(a.left + a.width, b.left + b.width) - rect.left;
+    rect.height = std::max(a.top + a.height, b.top + b.height) - rect.top;
+    return rect;
+}
+
+// copy rect's pixels from src to dst, where either one can be a whole width-wide image
+// or just the rect (srcStride/dstStride are the pixels per row)
+static void copyRect(const unsigned char* src, int srcStride, unsigned char* dst, int dstStride, const GifRect& rect){
+    for(int y = 0; y < rect.height; y++){
+        const unsigned char* row = src + 4 * (size_t)y * srcStride;
+        std::copy(row, row + 4 * rect.width, dst + 4 * (size_t)y * dstStride);
+    }
+}
+
+GifRect findChangedRect(const unsigned char* a, const unsigned char* b, int width, int height){
+    size_t rowBytes = 4 * (size_t)width;
+    int top = 0;
+    while(top < height && std::memcmp(a + top * rowBytes, b + top * rowBytes, rowBytes) == 0){
+        top++;
+    }
+    if(top == height){
+        return GifRect();
+    }
+    int bottom = height - 1;
+    while(std::memcmp(a + bottom * rowBytes, b + bottom * rowBytes, rowBytes) == 0){
+        bottom--;
+    }
+
+    // narrow down the columns a row at a time, only looking outside the ones found so far
+    int left = width;
+    int right = -1;
+    for(int y = top; y <= bottom; y++){
+        const unsigned char* rowA = a + y * rowBytes;
+        const unsigned char* rowB = b + y * rowBytes;
+        for(int x = 0; x < left; x++){
+            if(std::memcmp(rowA + 4 * x, rowB + 4 * x, 4) != 0){
+                left = x;
+                break;
+            }
+        }
+        for(int x = width - 1; x > right; x--){
+            if(std::memcmp(rowA + 4 * x, rowB + 4 * x, 4) != 0){
+                right = x;
+                break;
+            }
+        }
+    }
+
+    GifRect rect;
+    rect.left = left;
+    rect.top = top;
+    rect.width = right - left + 1;
+    rect.height = bottom - top + 1;
+    return rect;
+}
+
+GifFrameStore::GifFrameStore(){
+    width = 0;
+    height = 0;
+    keyframeInterval = 1;
+    bytes = 0;
+}
+
+void GifFrameStore::setup(int width, int height, int numFrames, int keyframeInterval){
+    clear();
+    this->width = width;
+    this->height = height;
+    this->keyframeInterval = std::max(1, keyframeInterval);
+    frames.resize(numFrames);
+}
+
+void GifFrameStore::clear(){
+    std::vector<StoredFrame>().swap(frames);
+    bytes = 0;
+}
+
+bool GifFrameStore::has(int index) const {
+    return index >= 0 && index < (int)frames.size() && frames[index].stored;
+}
+
+int GifFrameStore::findStored(int index) const {
+    for(int i = std::min(index, (int)frames.size() - 1); i >= 0; i--){
+        if(frames[i].stored){
+            return i;
+        }
+    }
+    return -1;
+}
+
+void GifFrameStore::store(int index, const unsigned char* pixels, const GifRect* changed){
+    // the next frame only holds what changed since this one, so it needs to be made whole
+    // before this one gets replaced. the frames after it stay as they are, they only depend
+    // on the next frame's pixels and those don't change
+    if(frames[index].stored && has(index + 1) && !frames[index + 1].keyframe){
+        StoredFrame& next = frames[index + 1];
+        std::vector<unsigned char> nextPixels(4 * (size_t)width * height);
+        load(index + 1, nextPixels.data(), -1);
+        bytes -= next.pixels.size();
+        next.pixels.swap(nextPixels);
+        next.keyframe = true;
+        next.rect.left = 0;
+        next.rect.top = 0;
+        next.rect.width = width;
+        next.rect.height = height;
+        bytes += next.pixels.size();
+    }
+
+    StoredFrame& frame = frames[index];
+    bytes -= frame.pixels.size();
+    frame.stored = true;
+    frame.keyframe = changed == NULL || index % keyframeInterval == 0 || !has(index - 1);
+    if(!frame.keyframe){
+        // once the changes since the last keyframe add up to a whole frame, starting over is
+        // cheaper to load (and takes no more memory)
+        size_t changedBytes = 4 * (size_t)changed->width * changed->height;
+        for(int i = index - 1; !frames[i].keyframe; i--){
+            changedBytes += frames[i].pixels.size();
+        }
+        frame.keyframe = changedBytes >= 4 * (size_t)width * height;
+    }
+    if(frame.keyframe){
+        frame.rect.left = 0;
+        frame.rect.top = 0;
+        frame.rect.width = width;
+        frame.rect.height = height;
+    }else{
+        frame.rect = *changed;
+    }
+
+    size_t rowBytes = 4 * (size_t)frame.rect.width;
+    std::vector<unsigned char>(rowBytes * frame.rect.height).swap(frame.pixels);
+    for(int y = 0; y < frame.rect.height; y++){
+        const unsigned char* row = pixels + 4 * ((size_t)(frame.rect.top + y) * width + frame.rect.left);
+        std::copy(row, row + rowBytes, frame.pixels.begin() + y * rowBytes);
+    }
+    bytes += frame.pixels.size();
+}
+
+void GifFrameStore::applyFrame(const StoredFrame& frame, unsigned char* pixels) const {
+    size_t rowBytes = 4 * (size_t)frame.rect.width;
+    for(int y = 0; y < frame.rect.height; y++){
+        const unsigned char* row = frame.pixels.data() + y * rowBytes;
+        std::copy(row, row + rowBytes, pixels + 4 * ((size_t)(frame.rect.top + y) * width + frame.rect.left));
+    }
+}
+
+bool GifFrameStore::load(int index, unsigned char* pixels, int pixelsIndex) const {
+    if(!has(index)){
+        return false;
+    }
+
+    // every frame that isn't a keyframe has the one before it stored, so going back from
+    // index ends up at either a keyframe or the frame that's already in pixels
+    int start = index;
+    while(start != pixelsIndex && !frames[start].keyframe){
+        start--;
+    }
+    if(start != pixelsIndex){
+        applyFrame(frames[start], pixels);
+    }
+    for(int i = start + 1; i <= index; i++){
+        applyFrame(frames[i], pixels);
+    }
+    return true;
+}
+
+size_t GifFrameStore::getBytes() const {
+    return bytes;
+}
+
+// DGifGetImageDesc adds an entry to SavedImages for every frame it reads, which we don't use
+static void forgetSavedImages(GifFileType* gif){
+    GifFreeSavedImages(gif);
+    gif->SavedImages = NULL;
+    gif->ImageCount = 0;
+}
+
+// the row the line-th line read of an interlaced frame (height rows tall) goes in
+static int interlacedRow(int line, int height){
+    for(int pass = 0; pass < 4; pass++){
+        int numRows = std::max(0, (height - interlaceStart[pass] + interlaceStep[pass] - 1) / interlaceStep[pass]);
+        if(line < numRows){
+            return interlaceStart[pass] + line * interlaceStep[pass];
+        }
+        line -= numRows;
+    }
+    return height;
+}
+
+/***
+    turning a row of color indices into rgba through a frame's color table. colors that are 0
+    (transparent) leave the pixel alone.
+***/
+static void expandColorsScalar(const GifPixelType* indices, int start, int count, const uint32_t* colors, unsigned char* out){
+    for(int x = start; x < count; x++){
+        uint32_t color = colors[indices[x]];
+        if(color != 0){
+            std::memcpy(out + 4 * x, &color, 4);
+        }
+    }
+}
+
+#if SIMD_X86
+// SSE2 has no gather, so the 4 colors get looked up one at a time and blended in together
+__attribute__((target("sse2")))
+static int expandColorsSse2(const GifPixelType* indices, int count, const uint32_t* colors, unsigned char* out){
+    int x = 0;
+    for(; x + 4 <= count; x += 4){
+        __m128i color = _mm_setr_epi32((int)colors[indices[x]], (int)colors[indices[x + 1]], (int)colors[indices[x + 2]], (int)colors[indices[x + 3]]);
+        __m128i transparent = _mm_cmpeq_epi32(color, _mm_setzero_si128());
+        __m128i old = _mm_loadu_si128((const __m128i*)(out + 4 * x));
+        _mm_storeu_si128((__m128i*)(out + 4 * x), _mm_or_si128(_mm_and_si128(transparent, old), _mm_andnot_si128(transparent, color)));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static int expandColorsAvx2(const GifPixelType* indices, int count, const uint32_t* colors, unsigned char* out){
+    int x = 0;
+    for(; x + 8 <= count; x += 8){
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(indices + x)));
+        __m256i color = _mm256_i32gather_epi32((const int*)colors, index, 4);
+        __m256i transparent = _mm256_cmpeq_epi32(color, _mm256_setzero_si256());
+        __m256i old = _mm256_loadu_si256((const __m256i*)(out + 4 * x));
+        _mm256_storeu_si256((__m256i*)(out + 4 * x), _mm256_blendv_epi8(color, old, transparent));
+    }
+    return x;
+}
+#endif
+
+static void expandColors(const GifPixelType* indices, int count, const uint32_t* colors, unsigned char* out){
+    int x = 0;
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            x = expandColorsAvx2(indices, count, colors, out);
+            break;
+        case SimdLevel::Sse2:
+            x = expandColorsSse2(indices, count, colors, out);
+            break;
+#endif
+        default:
+            break;
+    }
+    expandColorsScalar(indices, x, count, colors, out);
+}
+
+GifFrameSource::GifFrameSource(){
+    width = 0;
+    height = 0;
+    storeBudget = GIF_STORE_BYTES;
+    keyframeInterval = GIF_MIN_KEYFRAME_INTERVAL;
+    cacheCapacity = 2;
+}
+
+GifFrameSource::~GifFrameSource(){
+    close();
+}
+
+int GifFrameSource::readData(GifFileType* gifFile, GifByteType* buffer, int length){
+    Decoder* decoder = (Decoder*)gifFile->UserData;
+    const std::vector<unsigned char>& data = *decoder->fileData;
+    size_t count = std::min((size_t)length, data.size() - decoder->readPos);
+    std::memcpy(buffer, data.data() + decoder->readPos, count);
+    decoder->readPos += count;
+    return (int)count;
+}
+
+bool GifFrameSource::openDecoder(Decoder& decoder, int& error) const {
+    decoder.fileData = &fileData;
+    decoder.readPos = 0;
+    decoder.gif = DGifOpen(&decoder, readData, &error);
+    return decoder.gif != NULL;
+}
+
+void GifFrameSource::closeDecoder(Decoder& decoder){
+    if(decoder.gif != NULL){
+        int error;
+        DGifCloseFile(decoder.gif, &error);
+        decoder.gif = NULL;
+    }
+}
+
+bool GifFrameSource::open(const char* filename){
+    close();
+
+    std::ifstream file(filename, std::ios::binary);
+    if(!file){
+        return false;
+    }
+    fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    int error;
+    if(!openDecoder(decoder, error)){
+        std::cout << "couldn't open gif: " << GifErrorString(error) << "\n";
+        close();
+        return false;
+    }
+
+    if(!indexFrames()){
+        close();
+        return false;
+    }
+
+    size_t frameBytes = 4 * (size_t)width * height;
+    size_t maxKeyframes = std::max((size_t)1, (size_t)GIF_KEYFRAME_BYTES / frameBytes);
+    keyframeInterval = std::max(GIF_MIN_KEYFRAME_INTERVAL, (int)((frames.size() + maxKeyframes - 1) / maxKeyframes));
+    cacheCapacity = std::max((size_t)2, (size_t)GIF_CACHE_BYTES / frameBytes);
+
+    canvas.pixels.assign(frameBytes, 0);
+    canvas.index = -1;
+    canvas.disposalBackupIndex = -1;
+    decodedFrames.setup(width, height, (int)frames.size(), keyframeInterval);
+    editedFrames.setup(width, height, (int)frames.size(), GIF_EDIT_KEYFRAME_INTERVAL);
+    return true;
+}
+
+// go through the records once, noting where each frame starts, where it goes and how it gets
+// composited. the pixel data
+// gets skipped over a block at a time without decompressing it
+bool GifFrameSource::indexFrames(){
+    GifFileType* gif = decoder.gif;
+    GifFrameInfo nextFrame;
+    GifRecordType recordType;
+    int firstWidth = 0;
+    int firstHeight = 0;
+    bool ok = true;
+
+    do{
+        size_t recordStart = decoder.readPos;
+        if(DGifGetRecordType(gif, &recordType) == GIF_ERROR){
+            ok = false;
+            break;
+        }
+
+        if(recordType == IMAGE_DESC_RECORD_TYPE){
+            if(DGifGetImageDesc(gif) == GIF_ERROR){
+                ok = false;
+                break;
+            }
+            if(frames.empty()){
+                firstWidth = gif->Image.Width;
+                firstHeight = gif->Image.Height;
+            }
+            nextFrame.offset = recordStart;
+            nextFrame.rect.left = gif->Image.Left;
+            nextFrame.rect.top = gif->Image.Top;
+            nextFrame.rect.width = gif->Image.Width;
+            nextFrame.rect.height = gif->Image.Height;
+            frames.push_back(nextFrame);
+            nextFrame = GifFrameInfo();
+
+            int codeSize;
+            GifByteType* block;
+            ok = DGifGetCode(gif, &codeSize, &block) != GIF_ERROR;
+            while(ok && block != NULL){
+                ok = DGifGetCodeNext(gif, &block) != GIF_ERROR;
+            }
+        }else if(recordType == EXTENSION_RECORD_TYPE){
+            int extensionCode;
+            GifByteType* extension;
+            ok = DGifGetExtension(gif, &extensionCode, &extension) != GIF_ERROR;
+            if(ok && extensionCode == GRAPHICS_EXT_FUNC_CODE && extension != NULL){
+                GraphicsControlBlock gcb;
+                if(DGifExtensionToGCB(extension[0], extension + 1, &gcb) == GIF_OK){
+                    nextFrame.delay = 10 * gcb.DelayTime;
+                    nextFrame.disposal = gcb.DisposalMode;
+                    nextFrame.transparentIndex = gcb.TransparentColor;
+                }
+            }
+            while(ok && extension != NULL){
+                ok = DGifGetExtensionNext(gif, &extension) != GIF_ERROR;
+            }
+        }
+    }while(ok && recordType != TERMINATE_RECORD_TYPE);
+
+    forgetSavedImages(gif);
+
+    if(!ok){
+        // a truncated gif still gets whatever frames were found before the error
+        std::cout << "error reading gif: " << GifErrorString(gif->Error) << "\n";
+    }
+    if(frames.empty()){
+        return false;
+    }
+
+    width = gif->SWidth > 0 ? gif->SWidth : firstWidth;
+    height = gif->SHeight > 0 ? gif->SHeight : firstHeight;
+
+    // parts of frames outside the logical screen don't get shown
+    for(GifFrameInfo& frame : frames){
+        GifRect& rect = frame.rect;
+        rect.width = std::max(0, std::min(rect.width, width - rect.left));
+        rect.height = std::max(0, std::min(rect.height, height - rect.top));
+        if(rect.width == 0 || rect.height == 0){
+            rect = GifRect();
+        }
+    }
+
+    // a frame doesn't depend on the ones before it if the screen gets cleared right before it,
+    // or if it covers all of it with nothing transparent (and isn't put back afterwards)
+    for(size_t i = 0; i < frames.size(); i++){
+        const GifFrameInfo& frame = frames[i];
+        bool coversScreen = frame.rect.width == width && frame.rect.height == height;
+        bool clearedBefore = i > 0 && frames[i - 1].disposal == DISPOSE_BACKGROUND && frames[i - 1].rect.width == width && frames[i - 1].rect.height == height;
+        frames[i].independent = i == 0 || clearedBefore || (coversScreen && frame.transparentIndex == NO_TRANSPARENT_COLOR && frame.disposal != DISPOSE_PREVIOUS);
+    }
+    return width > 0 && height > 0;
+}
+
+void GifFrameSource::close(){
+    closeDecoder(decoder);
+    std::vector<unsigned char>().swap(fileData);
+    std::vector<unsigned char>().swap(canvas.pixels);
+    std::vector<unsigned char>().swap(canvas.disposalBackup);
+    std::vector<unsigned char>().swap(scratch);
+    std::vector<GifPixelType>().swap(frameIndices.indices);
+    std::vector<GifPixelType>().swap(frameIndices.line);
+    frames.clear();
+    decodedFrames.clear();
+    editedFrames.clear();
+    cache.clear();
+    width = 0;
+    height = 0;
+    canvas.index = -1;
+    canvas.disposalBackupIndex = -1;
+}
+
+bool GifFrameSource::isOpen() const {
+    return decoder.gif != NULL;
+}
+
+int GifFrameSource::getWidth() const {
+    return width;
+}
+
+int GifFrameSource::getHeight() const {
+    return height;
+}
+
+int GifFrameSource::getFrameCount() const {
+    return (int)frames.size();
+}
+
+int GifFrameSource::getFrameDelay(int index) const {
+    return frames[index].delay;
+}
+
+void GifFrameSource::setFrameDelay(int index, int delay){
+    frames[index].delay = delay;
+}
+
+int GifFrameSource::findIndependentFrame(int index) const {
+    while(index > 0 && !frames[index].independent){
+        index--;
+    }
+    return index;
+}
+
+bool GifFrameSource::canDecodeAfter(const Canvas& canvas, int index) const {
+    return index < 0 || frames[index].disposal != DISPOSE_PREVIOUS || canvas.disposalBackupIndex == index;
+}
+
+bool GifFrameSource::readFrame(Decoder& decoder, int index, FrameIndices& frame) const {
+    GifFileType* gif = decoder.gif;
+    const GifRect& rect = frames[index].rect;
+    frame.height = 0;
+    frame.numLines = 0;
+    frame.interlaced = false;
+    frame.error = 0;
+
+    decoder.readPos = frames[index].offset;
+    GifRecordType recordType;
+    if(DGifGetRecordType(gif, &recordType) == GIF_ERROR){
+        frame.error = gif->Error;
+        return false;
+    }
+    if(recordType != IMAGE_DESC_RECORD_TYPE){
+        frame.error = D_GIF_ERR_WRONG_RECORD;
+        return false;
+    }
+    if(DGifGetImageDesc(gif) == GIF_ERROR){
+        frame.error = gif->Error;
+        forgetSavedImages(gif);
+        return false;
+    }
+
+    // giflib frees the frame's color map once the next one gets read, so it's copied into the table now
+    const GifImageDesc& desc = gif->Image;
+    const ColorMapObject* colorMap = desc.ColorMap ? desc.ColorMap : gif->SColorMap;
+    int numColors = colorMap != NULL ? colorMap->ColorCount : 0;
+    for(int c = 0; c < 256; c++){
+        unsigned char rgba[4] = {0, 0, 0, 0};
+        if(c < numColors && c != frames[index].transparentIndex){
+            rgba[0] = colorMap->Colors[c].Red;
+            rgba[1] = colorMap->Colors[c].Green;
+            rgba[2] = colorMap->Colors[c].Blue;
+            rgba[3] = 255;
+        }
+        std::memcpy(&frame.colors[c], rgba, 4);
+    }
+
+    frame.height = desc.Height;
+    frame.interlaced = desc.Interlace;
+    frame.indices.resize((size_t)rect.width * rect.height);
+    frame.line.resize(desc.Width);
+    for(int line = 0; line < desc.Height; line++){
+        int row = desc.Interlace ? interlacedRow(line, desc.Height) : line;
+        // lines below the screen still have to be read to get past them
+        bool visible = row < rect.height;
+        GifPixelType* out = visible && rect.width == desc.Width ? &frame.indices[(size_t)row * rect.width] : frame.line.data();
+        if(DGifGetLine(gif, out, desc.Width) == GIF_ERROR){
+            frame.error = gif->Error;
+            break;
+        }
+        if(visible && out == frame.line.data()){
+            std::copy(frame.line.begin(), frame.line.begin() + rect.width, frame.indices.begin() + (size_t)row * rect.width);
+        }
+        frame.numLines++;
+    }
+
+    forgetSavedImages(gif);
+    return frame.error == 0;
+}
+
+void GifFrameSource::compositeFrame(Canvas& canvas, int index, const FrameIndices& frame, GifRect& changed) const {
+    changed = GifRect();
+    if(index > 0 && canvas.index == index - 1){
+        const GifFrameInfo& previous = frames[index - 1];
+        if(previous.disposal == DISPOSE_BACKGROUND){
+            // browsers clear to transparent rather than the background color, and so do we
+            for(int y = 0; y < previous.rect.height; y++){
+                unsigned char* row = canvas.pixels.data() + 4 * ((size_t)(previous.rect.top + y) * width + previous.rect.left);
+                std::fill(row, row + 4 * previous.rect.width, 0);
+            }
+            changed = previous.rect;
+        }else if(previous.disposal == DISPOSE_PREVIOUS){
+            copyRect(canvas.disposalBackup.data(), previous.rect.width, canvas.pixels.data() + 4 * ((size_t)previous.rect.top * width + previous.rect.left), width, previous.rect);
+            changed = previous.rect;
+        }
+    }
+
+    const GifRect& rect = frames[index].rect;
+    changed = unionRect(changed, rect);
+    if(frames[index].disposal == DISPOSE_PREVIOUS){
+        canvas.disposalBackup.resize(4 * (size_t)rect.width * rect.height);
+        copyRect(canvas.pixels.data() + 4 * ((size_t)rect.top * width + rect.left), width, canvas.disposalBackup.data(), rect.width, rect);
+        canvas.disposalBackupIndex = index;
+    }
+
+    for(int line = 0; line < frame.numLines; line++){
+        int row = frame.interlaced ? interlacedRow(line, frame.height) : line;
+        if(row < rect.height){
+            unsigned char* out = canvas.pixels.data() + 4 * ((size_t)(rect.top + row) * width + rect.left);
+            expandColors(frame.indices.data() + (size_t)row * rect.width, rect.width, frame.colors, out);
+        }
+    }
+    canvas.index = index;
+}
+
+void GifFrameSource::storeDecodedFrame(const Canvas& canvas, int index, const GifRect& changed, bool runStart){
+    if(decodedFrames.has(index)){
+        return;
+    }
+    if(index % keyframeInterval == 0){
+        decodedFrames.store(index, canvas.pixels.data(), NULL);
+    }else if(decodedFrames.getBytes() < storeBudget){
+        if(runStart){
+            decodedFrames.store(index, canvas.pixels.data(), NULL);
+        }else if(decodedFrames.has(index - 1)){
+            decodedFrames.store(index, canvas.pixels.data(), &changed);
+        }
+    }
+}
+
+const unsigned char* GifFrameSource::getFrame(int index){
+    for(auto it = cache.begin(); it != cache.end(); ++it){
+        if(it->index == index){
+            cache.splice(cache.begin(), cache, it);
+            return cache.front().pixels.data();
+        }
+    }
+
+    // reuse the least recently used frame's memory once the cache is full
+    if(cache.size() < cacheCapacity){
+        cache.emplace_front();
+    }else{
+        cache.splice(cache.begin(), cache, std::prev(cache.end()));
+    }
+    CachedFrame& cached = cache.front();
+    cached.index = index;
+    cached.pixels.resize(canvas.pixels.size());
+
+    if(editedFrames.load(index, cached.pixels.data(), -1)){
+        return cached.pixels.data();
+    }
+
+    if(decodedFrames.has(index)){
+        decodedFrames.load(index, canvas.pixels.data(), canvas.index);
+        canvas.index = index;
+    }else{
+        // keep going from the frame in canvas if that's no further back than the closest stored
+        // frame or independent frame, otherwise start from whichever of those is closer.
+        // a frame that gets put back to how things were before it needs what was under it, which
+        // only the decoder has, so decoding can't start right after one that was loaded from the store
+        int stored = decodedFrames.findStored(index);
+        while(stored >= 0 && !canDecodeAfter(canvas, stored)){
+            stored = decodedFrames.findStored(stored - 1);
+        }
+        int independent = findIndependentFrame(index);
+        int start = std::max(stored + 1, independent);
+        bool runStart = false;
+        if(canvas.index < start - 1 || canvas.index > index || !canDecodeAfter(canvas, canvas.index)){
+            if(stored >= independent){
+                decodedFrames.load(stored, canvas.pixels.data(), canvas.index);
+                canvas.index = stored;
+            }else{
+                std::fill(canvas.pixels.begin(), canvas.pixels.end(), 0);
+                canvas.index = -1;
+                runStart = true;
+            }
+        }else{
+            start = canvas.index + 1;
+        }
+
+        for(int i = start; i <= index; i++){
+            GifRect changed;
+            if(!readFrame(decoder, i, frameIndices)){
+                std::cout << "error decoding gif frame " << i << ": " << GifErrorString(frameIndices.error) << "\n";
+            }
+            compositeFrame(canvas, i, frameIndices, changed);
+            storeDecodedFrame(canvas, i, changed, runStart && i == start);
+        }
+    }
+
+    std::copy(canvas.pixels.begin(), canvas.pixels.end(), cached.pixels.begin());
+    return cached.pixels.data();
+}
+
+void GifFrameSource::setFrame(int index, const unsigned char* pixels){
+    // kept as just what changed since the edited frame before it, if there is one
+    GifRect changed;
+    const GifRect* delta = NULL;
+    if(editedFrames.has(index - 1)){
+        scratch.resize(canvas.pixels.size());
+        editedFrames.load(index - 1, scratch.data(), -1);
+        changed = findChangedRect(scratch.data(), pixels, width, height);
+        delta = &changed;
+    }
+    editedFrames.store(index, pixels, delta);
+
+    for(auto it = cache.begin(); it != cache.end(); ++it){
+        if(it->index == index){
+            cache.erase(it);
+            break;
+        }
+    }
+}
+
+void GifFrameSource::decodeRun(Decoder& decoder, Canvas& canvas, int first, int last, const FrameHandler* handleFrame){
+    std::fill(canvas.pixels.begin(), canvas.pixels.end(), 0);
+    canvas.index = -1;
+
+    // frame n gets read into slot n % 2, so the reader can be one frame ahead of the compositing
+    FrameIndices slots[2];
+    std::mutex mutex;
+    std::condition_variable progress;
+    int numRead = 0;
+    int numComposited = 0;
+
+    auto readFrames = [&](){
+        for(int n = 0; first + n < last; n++){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                progress.wait(lock, [&](){ return n - numComposited < 2; });
+            }
+            readFrame(decoder, first + n, slots[n % 2]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                numRead = n + 1;
+            }
+            progress.notify_all();
+        }
+    };
+
+    // a single frame has nothing to overlap with
+    std::thread reader;
+    if(last - first > 1){
+        reader = std::thread(readFrames);
+    }else{
+        readFrames();
+    }
+
+    for(int n = 0; first + n < last; n++){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            progress.wait(lock, [&](){ return numRead > n; });
+        }
+        const FrameIndices& frame = slots[n % 2];
+        if(frame.error != 0){
+            std::cout << "error decoding gif frame " << first + n << ": " << GifErrorString(frame.error) << "\n";
+        }
+        GifRect changed;
+        compositeFrame(canvas, first + n, frame, changed);
+        if(handleFrame != NULL){
+            (*handleFrame)(first + n, canvas.pixels.data());
+        }else{
+            storeDecodedFrame(canvas, first + n, changed, n == 0);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            numComposited = n + 1;
+        }
+        progress.notify_all();
+    }
+
+    if(reader.joinable()){
+        reader.join();
+    }
+}
+
+std::vector<int> GifFrameSource::findRunStarts() const {
+    std::vector<int> runStarts;
+    for(int i = 0; i < (int)frames.size(); i++){
+        if(frames[i].independent){
+            runStarts.push_back(i);
+        }
+    }
+    return runStarts;
+}
+
+bool GifFrameSource::framesFitInStore() const {
+    return 4 * (size_t)width * height * frames.size() <= storeBudget;
+}
+
+void GifFrameSource::setStoreBudget(size_t bytes){
+    storeBudget = bytes;
+}
+
+size_t GifFrameSource::getStoreBudget() const {
+    return storeBudget;
+}
+
+void GifFrameSource::decodeFrames(){
+    if(!framesFitInStore()){
+        return;
+    }
+    std::vector<int> runStarts = findRunStarts();
+
+    parallelFor(0, (int)runStarts.size(), [&](int start, int end){
+        // each chunk of runs gets its own decoder and canvas
+        Decoder runDecoder;
+        Canvas runCanvas;
+        for(int run = start; run < end; run++){
+            int first = runStarts[run];
+            int last = run + 1 < (int)runStarts.size() ? runStarts[run + 1] : (int)frames.size();
+            bool stored = true;
+            for(int i = first; stored && i < last; i++){
+                stored = decodedFrames.has(i);
+            }
+            if(stored){
+                continue;
+            }
+
+            if(runDecoder.gif == NULL){
+                int error;
+                if(!openDecoder(runDecoder, error)){
+                    std::cout << "couldn't open gif: " << GifErrorString(error) << "\n";
+                    return;
+                }
+                runCanvas.pixels.resize(canvas.pixels.size());
+            }
+            decodeRun(runDecoder, runCanvas, first, last, NULL);
+        }
+        closeDecoder(runDecoder);
+    });
+}
+
+void GifFrameSource::forEachFrame(const FrameHandler& handleFrame){
+    int numFrames = (int)frames.size();
+    if(framesFitInStore()){
+        decodeFrames();
+        for(int i = 0; i < numFrames; i++){
+            handleFrame(i, getFrame(i));
+        }
+        return;
+    }
+
+    size_t frameBytes = canvas.pixels.size();
+    scratch.resize(frameBytes);
+    auto handleDecodedFrame = [&](int index, const unsigned char* pixels){
+        if(editedFrames.load(index, scratch.data(), -1)){
+            handleFrame(index, scratch.data());
+        }else{
+            handleFrame(index, pixels);
+        }
+    };
+    FrameHandler handleInOrder(handleDecodedFrame);
+
+    // runs get decoded in parallel into a window of as many frames as the cache holds (or the store, if
+    // that's less, but at least one per thread), which then get handed over in order. a run that doesn't
+    // fit in the window on its own gets handed over frame by frame as it's decoded instead
+    std::vector<int> runStarts = findRunStarts();
+    runStarts.push_back(numFrames);
+    int windowFrames = std::max((int)std::min(cacheCapacity, storeBudget / frameBytes), getThreadCount());
+    std::vector<unsigned char> window;
+
+    int run = 0;
+    while(run + 1 < (int)runStarts.size()){
+        int first = runStarts[run];
+        if(runStarts[run + 1] - first > windowFrames){
+            Decoder runDecoder;
+            Canvas runCanvas;
+            int error;
+            if(!openDecoder(runDecoder, error)){
+                std::cout << "couldn't open gif: " << GifErrorString(error) << "\n";
+                return;
+            }
+            runCanvas.pixels.resize(frameBytes);
+            decodeRun(runDecoder, runCanvas, first, runStarts[run + 1], &handleInOrder);
+            closeDecoder(runDecoder);
+            run++;
+            continue;
+        }
+
+        int lastRun = run + 1;
+        while(lastRun + 1 < (int)runStarts.size() && runStarts[lastRun + 1] - first <= windowFrames){
+            lastRun++;
+        }
+        int last = runStarts[lastRun];
+        window.resize((last - first) * frameBytes);
+
+        FrameHandler copyToWindow = [&](int index, const unsigned char* pixels){
+            std::copy(pixels, pixels + frameBytes, window.begin() + (index - first) * frameBytes);
+        };
+        parallelFor(run, lastRun, [&](int start, int end){
+            Decoder runDecoder;
+            Canvas runCanvas;
+            int error;
+            if(!openDecoder(runDecoder, error)){
+                std::cout << "couldn't open gif: " << GifErrorString(error) << "\n";
+                return;
+            }
+            runCanvas.pixels.resize(frameBytes);
+            for(int r = start; r < end; r++){
+                decodeRun(runDecoder, runCanvas, runStarts[r], runStarts[r + 1], &copyToWindow);
+            }
+            closeDecoder(runDecoder);
+        });
+
+        for(int i = first; i < last; i++){
+            handleDecodedFrame(i, window.data() + (i - first) * frameBytes);
+        }
+        run = lastRun;
+    }
+}
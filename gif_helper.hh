@@ -0,0 +1,251 @@
+#ifndef GIF_HELPER_H
+#define GIF_HELPER_H
+
+/***
+
+    streaming gif frames for the editor
+
+    instead of decoding the whole gif with DGifSlurp and keeping a full rgba copy of every frame,
+    opening a gif only reads through its records once to find where each frame starts (skipping
+    over the compressed pixel data). frames get decoded with DGifGetLine when they're asked for,
+    composited onto the logical screen one after another, and the last few get kept around in a
+    small cache.
+
+    compositing follows the graphics control extension of each frame: its transparent color index
+    leaves the pixels under it alone, and its disposal method says what happens to the frame's
+    rectangle before the next frame gets drawn (left as is, cleared to transparent, or put back
+    to how it was before the frame). the screen starts out transparent. only the frame's rectangle
+    and the one the frame before it disposed of get touched, so a frame costs as much as the area
+    it changes.
+
+    decoded frames also go into a GifFrameStore: every so often a whole frame is kept as a keyframe,
+    and in between only the rectangle that changed since the frame before. consecutive gif frames
+    usually only differ in a small area, so this takes a fraction of the memory of full frames and
+    going back to a frame that's been decoded before just means applying a few rectangles to the
+    keyframe before it. once the store is over its budget only keyframes get added, and the frames
+    after them are decoded again when they're needed.
+
+    frames that have been edited are kept in a store of their own and always win over the decoded ones.
+
+    decodeFrames() decodes every frame up front when they all fit in the store, and forEachFrame()
+    goes through every frame in order for things that need all of them (exporting), without storing
+    them when they don't fit. a frame that covers the whole screen with no transparency, or comes
+    right after one that clears the whole screen, doesn't depend on anything before it, so the frames
+    get split into runs starting at those and each run is decoded on its own thread. within a run the
+    lzw data of the next frame gets decompressed on a second thread while the current one is being
+    composited.
+    turning color indices into rgba goes through a 256 entry table, with SSE2/AVX2 versions.
+
+***/
+#include "external/giflib/gif_lib.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <vector>
+
+struct GifRect {
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// the smallest rectangle holding every pixel that differs between a and b (width x height rgba
+// pixels). width and height are 0 if there's no difference
+GifRect findChangedRect(const unsigned char* a, const unsigned char* b, int width, int height);
+
+// frames of an animation (all width x height rgba), each stored either whole or as the rectangle
+// that changed since the frame before it
+class GifFrameStore {
+    public:
+        GifFrameStore();
+
+        // forget everything and get ready for numFrames frames. frames whose index is a multiple of
+        // keyframeInterval are always stored whole, so loading one never has to go further back than that
+        void setup(int width, int height, int numFrames, int keyframeInterval);
+        void clear();
+
+        bool has(int index) const;
+
+        // the closest frame at or before index that's stored, -1 if there's none
+        int findStored(int index) const;
+
+        // store (or replace) frame index. if changed is given and the frame before is stored, only the
+        // pixels in changed are kept, so everything outside it has to be the same as in the frame before.
+        // (unless the changes since the last keyframe add up to a whole frame, then it becomes a keyframe)
+        void store(int index, const unsigned char* pixels, const GifRect* changed);
+
+        // write frame index into pixels. pixelsIndex is the stored frame pixels already holds (-1 if
+        // none), which saves starting over from the keyframe when it's on the way. false if the
+        // frame isn't stored
+        bool load(int index, unsigned char* pixels, int pixelsIndex) const;
+
+        // memory taken by the stored pixels
+        size_t getBytes() const;
+
+        // store() can be called from several threads at once as long as each works on its own run of
+        // frames, the first frame of a run is stored with changed = NULL and nothing gets replaced
+
+    private:
+        struct StoredFrame {
+            bool stored = false;
+            bool keyframe = false;
+            GifRect rect;
+            std::vector<unsigned char> pixels; // the rect's pixels, row after row
+        };
+
+        int width;
+        int height;
+        int keyframeInterval;
+        std::atomic<size_t> bytes;
+        std::vector<StoredFrame> frames;
+
+        void applyFrame(const StoredFrame& frame, unsigned char* pixels) const;
+};
+
+struct GifFrameInfo {
+    size_t offset = 0; // where the frame's image descriptor record starts in the file
+    GifRect rect;      // where it goes on the logical screen (clipped to it)
+    int delay = -1;    // in ms, -1 if the frame has no graphics control extension
+    int disposal = DISPOSAL_UNSPECIFIED;
+    int transparentIndex = NO_TRANSPARENT_COLOR;
+    bool independent = false; // looks the same whatever was on the screen before it
+};
+
+class GifFrameSource {
+    public:
+        GifFrameSource();
+        ~GifFrameSource();
+
+        GifFrameSource(const GifFrameSource&) = delete;
+        GifFrameSource& operator=(const GifFrameSource&) = delete;
+
+        // read in the file and find its frames. returns false if it isn't a gif giflib can read
+        bool open(const char* filename);
+        void close();
+        bool isOpen() const;
+
+        // size of the logical screen, which every frame gets composited onto
+        int getWidth() const;
+        int getHeight() const;
+        int getFrameCount() const;
+
+        int getFrameDelay(int index) const;
+        void setFrameDelay(int index, int delay);
+
+        // the rgba pixels (getWidth() x getHeight()) of the frame, decoding it if needed.
+        // stays valid until the next call to getFrame or setFrame
+        const unsigned char* getFrame(int index);
+
+        // replace the frame's pixels with edited ones
+        void setFrame(int index, const unsigned char* pixels);
+
+        // decode every frame that isn't stored yet, runs of independent frames in parallel. does nothing
+        // if the frames don't all fit in the store's budget, since the ones past it would just get thrown
+        // away and have to be decoded again when they're asked for
+        void decodeFrames();
+
+        // call handleFrame(index, pixels) for every frame in order, with what getFrame would give.
+        // pixels are only valid during the call. if the frames don't all fit in the store, runs get decoded
+        // in parallel a few frames at a time and handed over without being stored
+        typedef std::function<void(int index, const unsigned char* pixels)> FrameHandler;
+        void forEachFrame(const FrameHandler& handleFrame);
+
+        // how much memory decoded frames in between keyframes can take (GIF_STORE_BYTES by default).
+        // lowering it is for testing what happens to gifs that don't fit
+        void setStoreBudget(size_t bytes);
+        size_t getStoreBudget() const;
+
+    private:
+        struct CachedFrame {
+            int index;
+            std::vector<unsigned char> pixels;
+        };
+
+        // giflib reading from fileData. decodeFrames opens one for each thread
+        struct Decoder {
+            const std::vector<unsigned char>* fileData = NULL;
+            size_t readPos = 0;
+            GifFileType* gif = NULL;
+        };
+
+        // a frame's color indices (only the part inside its rect) and its color table as rgba, with the transparent color and any index past the end
+        // of the color map left at 0
+        struct FrameIndices {
+            std::vector<GifPixelType> indices; // rect.width x rect.height
+            std::vector<GifPixelType> line;    // a whole line of the frame as it's read
+            uint32_t colors[256];
+            int height = 0;   // lines in the frame (which can go past the bottom of the screen)
+            int numLines = 0; // lines read, less than height if there was an error
+            bool interlaced = false;
+            int error = 0;    // giflib error code, 0 if the frame was read fine
+        };
+
+        // the logical screen as frames get composited onto it
+        struct Canvas {
+            std::vector<unsigned char> pixels;
+            int index = -1; // the frame it holds, -1 if blank
+            // what was under the rect of the last frame composited with DISPOSE_PREVIOUS, before it was drawn
+            std::vector<unsigned char> disposalBackup;
+            int disposalBackupIndex = -1;
+        };
+
+        std::vector<unsigned char> fileData;
+        Decoder decoder;
+
+        int width;
+        int height;
+        std::vector<GifFrameInfo> frames;
+
+        // the frame last decoded or loaded
+        Canvas canvas;
+        FrameIndices frameIndices;
+
+        GifFrameStore decodedFrames;
+        GifFrameStore editedFrames;
+        size_t storeBudget;
+        int keyframeInterval;
+        std::vector<unsigned char> scratch;
+
+        std::list<CachedFrame> cache; // most recently used first
+        size_t cacheCapacity;
+
+        static int readData(GifFileType* gifFile, GifByteType* buffer, int length);
+
+        bool openDecoder(Decoder& decoder, int& error) const;
+        static void closeDecoder(Decoder& decoder);
+
+        bool indexFrames();
+
+        // the closest independent frame at or before index
+        int findIndependentFrame(int index) const;
+
+        // whether decoding can carry on from frame index being in canvas
+        bool canDecodeAfter(const Canvas& canvas, int index) const;
+
+        // decompress frame index. false if there was an error (frame.error says which)
+        bool readFrame(Decoder& decoder, int index, FrameIndices& frame) const;
+
+        // dispose of the frame before index if that's what canvas holds, draw frame index on top and set
+        // changed to the part of canvas that got touched
+        void compositeFrame(Canvas& canvas, int index, const FrameIndices& frame, GifRect& changed) const;
+
+        // keep a frame that was just decoded into canvas, if it's not stored already and the store has room.
+        // runStart is whether it's the first frame decoded since canvas was blank
+        void storeDecodedFrame(const Canvas& canvas, int index, const GifRect& changed, bool runStart);
+
+        // decode frames [first, last) into a blank canvas, reading each frame on another thread while
+        // the one before it gets composited. first has to be an independent frame. each frame goes to
+        // handleFrame if it's given (with the edits left out), otherwise into the store
+        void decodeRun(Decoder& decoder, Canvas& canvas, int first, int last, const FrameHandler* handleFrame);
+
+        // the first frame of each run of frames that can be decoded on their own
+        std::vector<int> findRunStarts() const;
+
+        // whether every frame fits in the store as a whole frame
+        bool framesFitInStore() const;
+};
+
+#endif
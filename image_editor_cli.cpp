@@ -0,0 +1,543 @@
+// headless batch processing for the filters in filters.cpp
+// this doesn't touch SDL or OpenGL at all so it can run on machines without a display.
+//
+// usage: image_editor_cli -f <filter>[,<filter>...] [options] <image> [<image>...]
+// e.g.   image_editor_cli -f saturate,crt --saturationVal 1.5 --brightboost 0.5 -o out -j 8 *.png
+//
+// it can also check filter output against golden checksums so filter optimizations don't silently change pixels:
+//        image_editor_cli -f all --separately --seed 1 --golden golden --record test_image.png synthetic:256x256
+//        image_editor_cli -f all --separately --seed 1 --golden golden --tolerance 1 test_image.png synthetic:256x256
+
+#include "filters.hh"
+#include "synthetic_image.hh"
+#include "thread_pool.hh"
+#include "simd_helper.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h> // for using with srand()
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// FilterParameters fields that can be set with --<name> <value>
+struct CliParam {
+    const char* name;
+    float FilterParameters::* floatField;
+    int FilterParameters::* intField;
+};
+
+static const CliParam cliParams[] = {
+    {"lumR", &FilterParameters::lumR, nullptr},
+    {"lumG", &FilterParameters::lumG, nullptr},
+    {"lumB", &FilterParameters::lumB, nullptr},
+    {"saturationVal", &FilterParameters::saturationVal, nullptr},
+    {"outlineLimit", nullptr, &FilterParameters::outlineLimit},
+    {"chanOffset", nullptr, &FilterParameters::chanOffset},
+    {"chanOffsetRandNum", nullptr, &FilterParameters::chanOffsetRandNum},
+    {"chunkSize", nullptr, &FilterParameters::chunkSize},
+    {"scanLineThickness", nullptr, &FilterParameters::scanLineThickness},
+    {"brightboost", &FilterParameters::brightboost, nullptr},
+    {"intensity", &FilterParameters::intensity, nullptr},
+    {"voronoiNeighborCount", nullptr, &FilterParameters::voronoiNeighborCount},
+    {"voronoiEdgeBlend", nullptr, &FilterParameters::voronoiEdgeBlend},
+    {"thinningIterations", nullptr, &FilterParameters::thinningIterations},
+    {"thinningMethod", nullptr, &FilterParameters::thinningMethod},
+    {"blurFactor", nullptr, &FilterParameters::blurFactor},
+    {"kuwaharaFactor", nullptr, &FilterParameters::kuwaharaFactor},
+    {"edgeKernel", nullptr, &FilterParameters::edgeKernel},
+    {"edgeChannels", nullptr, &FilterParameters::edgeChannels},
+    {"edgeMagnitude", nullptr, &FilterParameters::edgeMagnitude},
+};
+
+struct CliOptions {
+    std::vector<Filter> filters;
+    std::vector<std::string> inputs;
+    std::string outputDir;
+    std::string extension = ".png";
+    int jobs = 1;
+    int threads = 0; // threads each filter gets split across (0 = one per hardware thread)
+    bool separately = false; // apply each filter on its own instead of as a chain
+    std::string goldenDir;
+    bool recordGolden = false;
+    int tolerance = 0;
+    FilterParameters params;
+};
+
+// golden checksums (and the reference images for comparing with a tolerance) live in goldenDir
+struct GoldenChecksums {
+    std::map<std::string, std::string> checksums; // "<input> <filters>" -> hash
+    std::mutex lock;
+};
+
+static void printUsage(){
+    std::cout << "usage: image_editor_cli -f <filter>[,<filter>...] [options] <image> [<image>...]\n\n";
+    std::cout << "options:\n";
+    std::cout << "  -f, --filters <list>   comma-separated filters to apply in order\n";
+    std::cout << "  -o, --output <dir>     directory to write results to (default: next to each input)\n";
+    std::cout << "  -e, --format <ext>     output format: png, bmp or jpg (default: png)\n";
+    std::cout << "  -j, --jobs <n>         number of images to process at the same time (default: 1)\n";
+    std::cout << "  -t, --threads <n>      number of threads each filter is split across (default: one per cpu)\n";
+    std::cout << "  --simd <level>         scalar, sse2 or avx2 (default: the best one this cpu supports)\n";
+    std::cout << "  --seed <n>             random seed for voronoi/channel offset (default: current time)\n";
+    std::cout << "  --separately           apply each filter to the original image instead of chaining them\n";
+    std::cout << "  --golden <dir>         check the results against the golden checksums in <dir> instead of writing them\n";
+    std::cout << "  --record               with --golden, (re)write the golden checksums and reference images\n";
+    std::cout << "  --tolerance <n>        with --golden, allow each channel to differ from the reference image by up to n\n";
+    std::cout << "  -h, --help             show this message\n\n";
+    std::cout << "inputs can be image files or synthetic:<width>x<height>[:<seed>] for a generated image.\n";
+    std::cout << "-f all selects every filter. voronoi uses rand(), so use --seed and -j 1 for reproducible output.\n";
+    std::cout << "--thinningMethod is 0 for hilditch or 1 for zhang-suen.\n";
+    std::cout << "--edgeKernel is 0 for 3x3 sobel, 1 for scharr or 2 for 5x5 sobel, --edgeChannels is 0 for red, 1 for luminance\n";
+    std::cout << "or 2 for per channel, and --edgeMagnitude is 0 for sqrt(gx^2 + gy^2) or 1 for |gx| + |gy|.\n\n";
+
+    // dots is left out since it needs an SDL renderer
+    std::cout << "filters:";
+    for(int f = Filter::Grayscale; f <= Filter::EdgeDetection; f++){
+        if(f != Filter::Dots){
+            std::cout << " " << getFilterName(static_cast<Filter>(f));
+        }
+    }
+    std::cout << "\n\nfilter parameters:";
+    for(const CliParam& p : cliParams){
+        std::cout << " --" << p.name;
+    }
+    std::cout << "\n";
+}
+
+static bool parseFilterList(const std::string& list, std::vector<Filter>& filters){
+    if(list == "all"){
+        for(int f = Filter::Grayscale; f <= Filter::EdgeDetection; f++){
+            if(f != Filter::Dots){
+                filters.push_back(static_cast<Filter>(f));
+            }
+        }
+        return true;
+    }
+
+    size_t start = 0;
+    while(start <= list.size()){
+        size_t end = list.find(',', start);
+        if(end == std::string::npos){
+            end = list.size();
+        }
+
+        std::string name = list.substr(start, end - start);
+        Filter filter;
+        if(!getFilterByName(name, filter)){
+            std::cerr << "unknown filter: " << name << "\n";
+            return false;
+        }
+        if(filter == Filter::Dots){
+            std::cerr << "dots needs an SDL renderer and isn't available here\n";
+            return false;
+        }
+        filters.push_back(filter);
+
+        start = end + 1;
+    }
+    return true;
+}
+
+static bool setFilterParam(const std::string& name, const char* value, FilterParameters& params){
+    for(const CliParam& p : cliParams){
+        if(name == p.name){
+            if(p.floatField){
+                params.*(p.floatField) = (float)std::atof(value);
+            }else{
+                params.*(p.intField) = std::atoi(value);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns false if the program should exit
+static bool parseArgs(int argc, char** argv, CliOptions& options, int& exitCode){
+    bool seedSet = false;
+    unsigned int seed = 0;
+    bool randNumSet = false;
+
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if(arg == "-h" || arg == "--help"){
+            printUsage();
+            exitCode = 0;
+            return false;
+        }else if(arg == "--separately"){
+            options.separately = true;
+        }else if(arg == "--record"){
+            options.recordGolden = true;
+        }else if(arg.size() > 1 && arg[0] == '-'){
+            if(!hasValue){
+                std::cerr << "missing value for " << arg << "\n";
+                exitCode = 1;
+                return false;
+            }
+            const char* value = argv[++i];
+
+            if(arg == "-f" || arg == "--filters"){
+                if(!parseFilterList(value, options.filters)){
+                    exitCode = 1;
+                    return false;
+                }
+            }else if(arg == "-o" || arg == "--output"){
+                options.outputDir = value;
+            }else if(arg == "-e" || arg == "--format"){
+                options.extension = std::string(".") + value;
+            }else if(arg == "-j" || arg == "--jobs"){
+                options.jobs = std::max(1, std::atoi(value));
+            }else if(arg == "-t" || arg == "--threads"){
+                options.threads = std::max(0, std::atoi(value));
+            }else if(arg == "--simd"){
+                SimdLevel level;
+                if(!getSimdLevelByName(value, level)){
+                    std::cerr << "unknown simd level: " << value << "\n";
+                    exitCode = 1;
+                    return false;
+                }
+                setSimdLevel(level);
+            }else if(arg == "--seed"){
+                seed = (unsigned int)std::strtoul(value, nullptr, 10);
+                seedSet = true;
+            }else if(arg == "--golden"){
+                options.goldenDir = value;
+            }else if(arg == "--tolerance"){
+                options.tolerance = std::max(0, std::atoi(value));
+            }else if(arg.size() > 2 && arg[1] == '-' && setFilterParam(arg.substr(2), value, options.params)){
+                if(arg == "--chanOffsetRandNum") randNumSet = true;
+            }else{
+                std::cerr << "unknown option: " << arg << "\n";
+                exitCode = 1;
+                return false;
+            }
+        }else{
+            options.inputs.push_back(arg);
+        }
+    }
+
+    if(options.filters.empty() || options.inputs.empty()){
+        printUsage();
+        exitCode = 1;
+        return false;
+    }
+
+    if(options.recordGolden && options.goldenDir == ""){
+        std::cerr << "--record needs --golden <dir>\n";
+        exitCode = 1;
+        return false;
+    }
+
+    if(options.extension != ".png" && options.extension != ".bmp" && options.extension != ".jpg"){
+        std::cerr << "unsupported output format: " << options.extension.substr(1) << "\n";
+        exitCode = 1;
+        return false;
+    }
+
+    // initialize random seed
+    srand(seedSet ? seed : (unsigned int)time(NULL));
+    if(!randNumSet){
+        options.params.generateRandNum3();
+    }
+
+    return true;
+}
+
+static std::string getChainName(const std::vector<Filter>& chain){
+    std::string name;
+    for(Filter filter : chain){
+        if(name != "") name += "+";
+        name += getFilterName(filter);
+    }
+    return name;
+}
+
+// input name without the directory and extension, safe to use in a file name
+static std::string getBaseName(const std::string& input){
+    std::string name = input;
+    size_t slash = input.find_last_of("/\\");
+    if(slash != std::string::npos){
+        name = input.substr(slash + 1);
+    }
+    if(name.compare(0, 10, "synthetic:") != 0){
+        name = name.substr(0, name.find_last_of("."));
+    }
+    std::replace(name.begin(), name.end(), ':', '_');
+    return name;
+}
+
+static std::string getOutputFileName(const std::string& input, const std::vector<Filter>& chain, const CliOptions& options){
+    std::string dir;
+    size_t slash = input.find_last_of("/\\");
+    if(slash != std::string::npos){
+        dir = input.substr(0, slash + 1);
+    }
+
+    if(options.outputDir != ""){
+        dir = options.outputDir + "/";
+    }
+
+    // same naming as the exported images in the editor
+    std::string name = getBaseName(input);
+    if(options.separately){
+        name += "-" + getChainName(chain);
+    }
+    return dir + name + "-edit" + options.extension;
+}
+
+// loads an image file, or generates one for synthetic:<width>x<height>[:<seed>]
+static unsigned char* loadInput(const std::string& input, int& width, int& height){
+    if(input.compare(0, 10, "synthetic:") == 0){
+        unsigned int seed = 1234;
+        if(sscanf(input.c_str() + 10, "%dx%d:%u", &width, &height, &seed) < 2 || width <= 0 || height <= 0){
+            std::cerr << "bad synthetic image size: " << input << "\n";
+            return NULL;
+        }
+        unsigned char* imageData = (unsigned char*)malloc(4 * width * height);
+        generateSyntheticImage(imageData, width, height, seed);
+        return imageData;
+    }
+
+    int channels = 4;
+    unsigned char* imageData = stbi_load(input.c_str(), &width, &height, &channels, 4);
+    if(imageData == NULL){
+        std::cerr << "failed to load " << input << ": " << stbi_failure_reason() << "\n";
+    }
+    return imageData;
+}
+
+// 64-bit FNV-1a over the dimensions and pixels
+static std::string hashImage(const unsigned char* imageData, int width, int height){
+    uint64_t hash = 14695981039346656037ull;
+    auto addByte = [&hash](unsigned char byte){
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for(int i = 0; i < 4; i++){
+        addByte((unsigned char)(width >> (8 * i)));
+        addByte((unsigned char)(height >> (8 * i)));
+    }
+    for(int i = 0; i < 4 * width * height; i++){
+        addByte(imageData[i]);
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return std::string(hex);
+}
+
+static void loadGoldenChecksums(const std::string& goldenDir, GoldenChecksums& golden){
+    std::ifstream file(goldenDir + "/checksums.txt");
+    std::string line;
+    while(std::getline(file, line)){
+        // <hash> <input> <filters>
+        std::istringstream fields(line);
+        std::string hash;
+        std::string input;
+        std::string chain;
+        if(fields >> hash >> input >> chain){
+            golden.checksums[input + " " + chain] = hash;
+        }
+    }
+}
+
+static bool saveGoldenChecksums(const std::string& goldenDir, GoldenChecksums& golden){
+    std::ofstream file(goldenDir + "/checksums.txt");
+    for(auto const& entry : golden.checksums){
+        file << entry.second << " " << entry.first << "\n";
+    }
+    return (bool)file;
+}
+
+// record or check the result of one input + filter chain against the golden data
+static bool checkGolden(const std::string& input, const std::vector<Filter>& chain, const unsigned char* imageData, int width, int height, const CliOptions& options, GoldenChecksums& golden){
+    std::string key = getBaseName(input) + " " + getChainName(chain);
+    std::string referenceFile = options.goldenDir + "/" + getBaseName(input) + "-" + getChainName(chain) + ".png";
+    std::string hash = hashImage(imageData, width, height);
+
+    if(options.recordGolden){
+        if(!stbi_write_png(referenceFile.c_str(), width, height, 4, imageData, 4 * width)){
+            std::cerr << "failed to write " << referenceFile << "\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(golden.lock);
+        golden.checksums[key] = hash;
+        return true;
+    }
+
+    std::string expected;
+    {
+        std::lock_guard<std::mutex> guard(golden.lock);
+        auto entry = golden.checksums.find(key);
+        if(entry != golden.checksums.end()){
+            expected = entry->second;
+        }
+    }
+
+    if(expected == ""){
+        std::cout << "MISSING " << key << ": no golden checksum\n";
+        return false;
+    }
+    if(expected == hash){
+        std::cout << "ok      " << key << "\n";
+        return true;
+    }
+    if(options.tolerance == 0){
+        std::cout << "FAILED  " << key << ": checksum " << hash << " != " << expected << "\n";
+        return false;
+    }
+
+    // checksum differs, see if every channel is within the tolerance of the reference image
+    int refWidth = 0;
+    int refHeight = 0;
+    int channels = 4;
+    unsigned char* reference = stbi_load(referenceFile.c_str(), &refWidth, &refHeight, &channels, 4);
+    if(reference == NULL || refWidth != width || refHeight != height){
+        std::cout << "FAILED  " << key << ": checksum differs and reference image " << referenceFile << " is missing or a different size\n";
+        if(reference) stbi_image_free(reference);
+        return false;
+    }
+
+    int maxDiff = 0;
+    long numDiffering = 0;
+    for(int i = 0; i < 4 * width * height; i++){
+        int diff = std::abs((int)imageData[i] - (int)reference[i]);
+        if(diff > 0) numDiffering++;
+        maxDiff = std::max(maxDiff, diff);
+    }
+    stbi_image_free(reference);
+
+    bool passed = maxDiff <= options.tolerance;
+    std::cout << (passed ? "ok      " : "FAILED  ") << key << ": max channel difference " << maxDiff
+              << " (" << numDiffering << " channels differ)\n";
+    return passed;
+}
+
+static bool processImage(const std::string& input, const std::vector<Filter>& chain, const CliOptions& options, GoldenChecksums& golden){
+    int width = 0;
+    int height = 0;
+
+    unsigned char* imageData = loadInput(input, width, height);
+    if(imageData == NULL){
+        return false;
+    }
+
+    int pixelDataLen = width * height * 4;
+    unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
+
+    // each image gets its own copy of the params since the workers run at the same time
+    FilterParameters params = options.params;
+
+    for(Filter filter : chain){
+        std::copy(imageData, imageData + pixelDataLen, sourceImageCopy);
+        applyFilter(filter, imageData, sourceImageCopy, width, height, params);
+    }
+
+    bool succeeded = true;
+    if(options.goldenDir != ""){
+        succeeded = checkGolden(input, chain, imageData, width, height, options, golden);
+    }else{
+        std::string output = getOutputFileName(input, chain, options);
+        int written = 0;
+        if(options.extension == ".png"){
+            written = stbi_write_png(output.c_str(), width, height, 4, imageData, 4 * width);
+        }else if(options.extension == ".bmp"){
+            written = stbi_write_bmp(output.c_str(), width, height, 4, imageData);
+        }else{
+            written = stbi_write_jpg(output.c_str(), width, height, 4, imageData, 90);
+        }
+        if(!written){
+            std::cerr << "failed to write " << output << "\n";
+            succeeded = false;
+        }
+    }
+
+    delete[] sourceImageCopy;
+    stbi_image_free(imageData); // synthetic images are malloc'd as well
+
+    return succeeded;
+}
+
+int main(int argc, char** argv){
+    CliOptions options;
+    int exitCode = 0;
+
+    if(!parseArgs(argc, argv, options, exitCode)){
+        return exitCode;
+    }
+
+    stbi_set_flip_vertically_on_load(false);
+    setThreadCount(options.threads);
+
+    GoldenChecksums golden;
+    if(options.goldenDir != "" && !options.recordGolden){
+        loadGoldenChecksums(options.goldenDir, golden);
+    }
+
+    // one job per input and filter chain
+    std::vector<std::pair<std::string, std::vector<Filter>>> jobs;
+    for(const std::string& input : options.inputs){
+        if(options.separately){
+            for(Filter filter : options.filters){
+                jobs.push_back({input, std::vector<Filter>{filter}});
+            }
+        }else{
+            jobs.push_back({input, options.filters});
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // each worker grabs the next unprocessed job until there are none left
+    std::atomic<int> nextJob(0);
+    std::atomic<int> numFailed(0);
+    int numJobs = (int)jobs.size();
+
+    auto worker = [&](){
+        int idx;
+        while((idx = nextJob++) < numJobs){
+            if(!processImage(jobs[idx].first, jobs[idx].second, options, golden)){
+                numFailed++;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    int numWorkers = std::min(options.jobs, numJobs);
+    for(int i = 1; i < numWorkers; i++){
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+    for(std::thread& t : workers){
+        t.join();
+    }
+
+    if(options.recordGolden && !saveGoldenChecksums(options.goldenDir, golden)){
+        std::cerr << "failed to write " << options.goldenDir << "/checksums.txt\n";
+        numFailed++;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "processed " << (numJobs - numFailed) << " of " << numJobs << " images in " << elapsed.count() << "s\n";
+
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,471 @@
+#include "simd_helper.hh"
+
+#include <atomic>
+
+// keep the compiler from fusing the scalar float math into fma instructions (which -march=native
+// allows), so the scalar and vector versions round the same way on every build
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+static std::atomic<int> currentSimdLevel(-1); // -1 = not picked yet
+
+SimdLevel getSupportedSimdLevel(){
+#if SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        return SimdLevel::Avx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return SimdLevel::Sse2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+void setSimdLevel(SimdLevel level){
+    SimdLevel supported = getSupportedSimdLevel();
+    currentSimdLevel = (level > supported) ? supported : level;
+}
+
+SimdLevel getSimdLevel(){
+    int level = currentSimdLevel;
+    if(level < 0){
+        level = getSupportedSimdLevel();
+        currentSimdLevel = level;
+    }
+    return static_cast<SimdLevel>(level);
+}
+
+static const char* simdLevelNames[] = {"scalar", "sse2", "avx2"};
+
+const char* getSimdLevelName(SimdLevel level){
+    return simdLevelNames[level];
+}
+
+bool getSimdLevelByName(const std::string& name, SimdLevel& level){
+    for(int i = SimdLevel::Scalar; i <= SimdLevel::Avx2; i++){
+        if(name == simdLevelNames[i]){
+            level = static_cast<SimdLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/***
+    scalar versions (also used for the pixels left over after the vector loops)
+***/
+static int clampChannel(int channel){
+    if(channel > 255){
+        return 255;
+    }
+    if(channel < 0){
+        return 0;
+    }
+    return channel;
+}
+
+static void grayscaleScalar(unsigned char* pixelData, int numPixels){
+    for(int i = 0; i < numPixels*4; i += 4){
+        unsigned char grey = (pixelData[i] + pixelData[i+1] + pixelData[i+2]) / 3;
+        pixelData[i] = grey;
+        pixelData[i+1] = grey;
+        pixelData[i+2] = grey;
+    }
+}
+
+static void invertScalar(unsigned char* pixelData, int numPixels){
+    for(int i = 0; i < numPixels*4; i += 4){
+        pixelData[i] = 255 - pixelData[i];
+        pixelData[i+1] = 255 - pixelData[i+1];
+        pixelData[i+2] = 255 - pixelData[i+2];
+    }
+}
+
+static void saturateScalar(unsigned char* pixelData, int numPixels, float r1, float g1, float b1, float r2, float g2, float b2){
+    for(int i = 0; i < numPixels*4; i += 4){
+        int r = (int)pixelData[i];
+        int g = (int)pixelData[i+1];
+        int b = (int)pixelData[i+2];
+        pixelData[i] = (unsigned char)clampChannel((int)(r*r1 + g*g2 + b*b2));
+        pixelData[i+1] = (unsigned char)clampChannel((int)(r*r2 + g*g1 + b*b2));
+        pixelData[i+2] = (unsigned char)clampChannel((int)(r*r2 + g*g2 + b*b1));
+    }
+}
+
+static void crtScalar(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, bool highLine, float brightboost, float intensity){
+    for(int i = 0; i < numPixels*4; i += 4){
+        for(int j = 0; j < 3; j++){
+            float currChannel = sourceImageCopy[i + j] / 255.0f;
+            float newColorVal = highLine ?
+                ((1.0f + brightboost) - (0.2f * currChannel)) * currChannel :
+                ((1.0f - intensity) + (0.1f * currChannel)) * currChannel;
+            imageData[i + j] = (unsigned char)(255.0f * newColorVal);
+        }
+    }
+}
+
+static void lookupScalar(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, const int* table){
+    for(int i = 0; i < numPixels*4; i += 4){
+        imageData[i] = (unsigned char)table[sourceImageCopy[i]];
+        imageData[i+1] = (unsigned char)table[sourceImageCopy[i+1]];
+        imageData[i+2] = (unsigned char)table[sourceImageCopy[i+2]];
+    }
+}
+
+#if SIMD_X86
+/***
+    SSE2 versions, 8 pixels per iteration
+
+    each 32-bit lane holds one pixel (r in the low byte), so channels get pulled out
+    with shifts and masks and everything stays in pixel order
+***/
+
+// (sum * 21846) >> 16 == sum / 3 for every sum of three channels (0-765)
+#define DIV3_MULTIPLIER 21846
+
+__attribute__((target("sse2")))
+static inline __m128i grayscale4Sse2(__m128i pixels){
+    const __m128i channelMask = _mm_set1_epi32(0xff);
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+    const __m128i div3 = _mm_set1_epi32(DIV3_MULTIPLIER);
+
+    __m128i sum = _mm_add_epi32(
+        _mm_add_epi32(_mm_and_si128(pixels, channelMask), _mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask)),
+        _mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask)
+    );
+    // the upper 16 bits of each lane are 0 in both, so this is a 32-bit (sum * 21846) >> 16
+    __m128i grey = _mm_mulhi_epu16(sum, div3);
+
+    __m128i result = _mm_or_si128(grey, _mm_slli_epi32(grey, 8));
+    result = _mm_or_si128(result, _mm_slli_epi32(grey, 16));
+    return _mm_or_si128(result, _mm_and_si128(pixels, alphaMask));
+}
+
+__attribute__((target("sse2")))
+static void grayscaleSse2(unsigned char* pixelData, int numPixels){
+    int i = 0;
+    for(; i + 8 <= numPixels; i += 8){
+        __m128i* p = (__m128i*)(pixelData + i*4);
+        __m128i a = _mm_loadu_si128(p);
+        __m128i b = _mm_loadu_si128(p + 1);
+        _mm_storeu_si128(p, grayscale4Sse2(a));
+        _mm_storeu_si128(p + 1, grayscale4Sse2(b));
+    }
+    grayscaleScalar(pixelData + i*4, numPixels - i);
+}
+
+__attribute__((target("sse2")))
+static void invertSse2(unsigned char* pixelData, int numPixels){
+    const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+    int i = 0;
+    for(; i + 8 <= numPixels; i += 8){
+        __m128i* p = (__m128i*)(pixelData + i*4);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), rgbMask));
+        _mm_storeu_si128(p + 1, _mm_xor_si128(_mm_loadu_si128(p + 1), rgbMask));
+    }
+    invertScalar(pixelData + i*4, numPixels - i);
+}
+
+// clamp 32-bit lanes to 0-255 (sse2 has no min/max for 32-bit ints)
+__attribute__((target("sse2")))
+static inline __m128i clampChannelSse2(__m128i channel){
+    const __m128i maxChannel = _mm_set1_epi32(255);
+    channel = _mm_and_si128(channel, _mm_cmpgt_epi32(channel, _mm_setzero_si128()));
+    __m128i tooBig = _mm_cmpgt_epi32(channel, maxChannel);
+    return _mm_or_si128(_mm_andnot_si128(tooBig, channel), _mm_and_si128(tooBig, maxChannel));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i saturate4Sse2(__m128i pixels, __m128 r1, __m128 g1, __m128 b1, __m128 r2, __m128 g2, __m128 b2){
+    const __m128i channelMask = _mm_set1_epi32(0xff);
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+
+    __m128 r = _mm_cvtepi32_ps(_mm_and_si128(pixels, channelMask));
+    __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask));
+    __m128 b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask));
+
+    // same order of operations as the scalar version, and truncated like (int)
+    __m128i newR = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r1), _mm_mul_ps(g, g2)), _mm_mul_ps(b, b2)));
+    __m128i newG = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r2), _mm_mul_ps(g, g1)), _mm_mul_ps(b, b2)));
+    __m128i newB = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r2), _mm_mul_ps(g, g2)), _mm_mul_ps(b, b1)));
+
+    __m128i result = _mm_or_si128(clampChannelSse2(newR), _mm_slli_epi32(clampChannelSse2(newG), 8));
+    result = _mm_or_si128(result, _mm_slli_epi32(clampChannelSse2(newB), 16));
+    return _mm_or_si128(result, _mm_and_si128(pixels, alphaMask));
+}
+
+__attribute__((target("sse2")))
+static void saturateSse2(unsigned char* pixelData, int numPixels, float r1, float g1, float b1, float r2, float g2, float b2){
+    __m128 vr1 = _mm_set1_ps(r1), vg1 = _mm_set1_ps(g1), vb1 = _mm_set1_ps(b1);
+    __m128 vr2 = _mm_set1_ps(r2), vg2 = _mm_set1_ps(g2), vb2 = _mm_set1_ps(b2);
+    int i = 0;
+    for(; i + 8 <= numPixels; i += 8){
+        __m128i* p = (__m128i*)(pixelData + i*4);
+        __m128i a = _mm_loadu_si128(p);
+        __m128i b = _mm_loadu_si128(p + 1);
+        _mm_storeu_si128(p, saturate4Sse2(a, vr1, vg1, vb1, vr2, vg2, vb2));
+        _mm_storeu_si128(p + 1, saturate4Sse2(b, vr1, vg1, vb1, vr2, vg2, vb2));
+    }
+    saturateScalar(pixelData + i*4, numPixels - i, r1, g1, b1, r2, g2, b2);
+}
+
+// (base + slope*c) * c for one channel, returned as the low byte of (int)(255 * value) like the scalar cast
+__attribute__((target("sse2")))
+static inline __m128i crtChannelSse2(__m128i channel, __m128 base, __m128 slope){
+    const __m128 scale = _mm_set1_ps(255.0f);
+    __m128 c = _mm_div_ps(_mm_cvtepi32_ps(channel), scale);
+    __m128 value = _mm_mul_ps(_mm_add_ps(base, _mm_mul_ps(slope, c)), c);
+    return _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(scale, value)), _mm_set1_epi32(0xff));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i crt4Sse2(__m128i pixels, __m128i dest, __m128 base, __m128 slope){
+    const __m128i channelMask = _mm_set1_epi32(0xff);
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+
+    __m128i r = crtChannelSse2(_mm_and_si128(pixels, channelMask), base, slope);
+    __m128i g = crtChannelSse2(_mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask), base, slope);
+    __m128i b = crtChannelSse2(_mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask), base, slope);
+
+    __m128i result = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+    result = _mm_or_si128(result, _mm_slli_epi32(b, 16));
+    return _mm_or_si128(result, _mm_and_si128(dest, alphaMask));
+}
+
+__attribute__((target("sse2")))
+static void crtSse2(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, bool highLine, float brightboost, float intensity){
+    // high lines: ((1 + brightboost) - 0.2c)c, low lines: ((1 - intensity) + 0.1c)c
+    __m128 base = _mm_set1_ps(highLine ? (1.0f + brightboost) : (1.0f - intensity));
+    __m128 slope = _mm_set1_ps(highLine ? -0.2f : 0.1f);
+    int i = 0;
+    for(; i + 8 <= numPixels; i += 8){
+        const __m128i* src = (const __m128i*)(sourceImageCopy + i*4);
+        __m128i* dst = (__m128i*)(imageData + i*4);
+        __m128i a = crt4Sse2(_mm_loadu_si128(src), _mm_loadu_si128(dst), base, slope);
+        __m128i b = crt4Sse2(_mm_loadu_si128(src + 1), _mm_loadu_si128(dst + 1), base, slope);
+        _mm_storeu_si128(dst, a);
+        _mm_storeu_si128(dst + 1, b);
+    }
+    crtScalar(imageData + i*4, sourceImageCopy + i*4, numPixels - i, highLine, brightboost, intensity);
+}
+
+/***
+    AVX2 versions, 16 pixels per iteration (same approach as SSE2 with twice the lanes)
+***/
+__attribute__((target("avx2")))
+static inline __m256i grayscale8Avx2(__m256i pixels){
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+    const __m256i div3 = _mm256_set1_epi32(DIV3_MULTIPLIER);
+
+    __m256i sum = _mm256_add_epi32(
+        _mm256_add_epi32(_mm256_and_si256(pixels, channelMask), _mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask)),
+        _mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask)
+    );
+    __m256i grey = _mm256_mulhi_epu16(sum, div3);
+
+    __m256i result = _mm256_or_si256(grey, _mm256_slli_epi32(grey, 8));
+    result = _mm256_or_si256(result, _mm256_slli_epi32(grey, 16));
+    return _mm256_or_si256(result, _mm256_and_si256(pixels, alphaMask));
+}
+
+__attribute__((target("avx2")))
+static void grayscaleAvx2(unsigned char* pixelData, int numPixels){
+    int i = 0;
+    for(; i + 16 <= numPixels; i += 16){
+        __m256i* p = (__m256i*)(pixelData + i*4);
+        __m256i a = _mm256_loadu_si256(p);
+        __m256i b = _mm256_loadu_si256(p + 1);
+        _mm256_storeu_si256(p, grayscale8Avx2(a));
+        _mm256_storeu_si256(p + 1, grayscale8Avx2(b));
+    }
+    grayscaleSse2(pixelData + i*4, numPixels - i);
+}
+
+__attribute__((target("avx2")))
+static void invertAvx2(unsigned char* pixelData, int numPixels){
+    const __m256i rgbMask = _mm256_set1_epi32(0x00ffffff);
+    int i = 0;
+    for(; i + 16 <= numPixels; i += 16){
+        __m256i* p = (__m256i*)(pixelData + i*4);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), rgbMask));
+        _mm256_storeu_si256(p + 1, _mm256_xor_si256(_mm256_loadu_si256(p + 1), rgbMask));
+    }
+    invertSse2(pixelData + i*4, numPixels - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i saturate8Avx2(__m256i pixels, __m256 r1, __m256 g1, __m256 b1, __m256 r2, __m256 g2, __m256 b2){
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxChannel = _mm256_set1_epi32(255);
+
+    __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(pixels, channelMask));
+    __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask));
+    __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask));
+
+    __m256i newR = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, r1), _mm256_mul_ps(g, g2)), _mm256_mul_ps(b, b2)));
+    __m256i newG = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, r2), _mm256_mul_ps(g, g1)), _mm256_mul_ps(b, b2)));
+    __m256i newB = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, r2), _mm256_mul_ps(g, g2)), _mm256_mul_ps(b, b1)));
+
+    newR = _mm256_min_epi32(_mm256_max_epi32(newR, zero), maxChannel);
+    newG = _mm256_min_epi32(_mm256_max_epi32(newG, zero), maxChannel);
+    newB = _mm256_min_epi32(_mm256_max_epi32(newB, zero), maxChannel);
+
+    __m256i result = _mm256_or_si256(newR, _mm256_slli_epi32(newG, 8));
+    result = _mm256_or_si256(result, _mm256_slli_epi32(newB, 16));
+    return _mm256_or_si256(result, _mm256_and_si256(pixels, alphaMask));
+}
+
+__attribute__((target("avx2")))
+static void saturateAvx2(unsigned char* pixelData, int numPixels, float r1, float g1, float b1, float r2, float g2, float b2){
+    __m256 vr1 = _mm256_set1_ps(r1), vg1 = _mm256_set1_ps(g1), vb1 = _mm256_set1_ps(b1);
+    __m256 vr2 = _mm256_set1_ps(r2), vg2 = _mm256_set1_ps(g2), vb2 = _mm256_set1_ps(b2);
+    int i = 0;
+    for(; i + 16 <= numPixels; i += 16){
+        __m256i* p = (__m256i*)(pixelData + i*4);
+        __m256i a = _mm256_loadu_si256(p);
+        __m256i b = _mm256_loadu_si256(p + 1);
+        _mm256_storeu_si256(p, saturate8Avx2(a, vr1, vg1, vb1, vr2, vg2, vb2));
+        _mm256_storeu_si256(p + 1, saturate8Avx2(b, vr1, vg1, vb1, vr2, vg2, vb2));
+    }
+    saturateSse2(pixelData + i*4, numPixels - i, r1, g1, b1, r2, g2, b2);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i crtChannelAvx2(__m256i channel, __m256 base, __m256 slope){
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    __m256 c = _mm256_div_ps(_mm256_cvtepi32_ps(channel), scale);
+    __m256 value = _mm256_mul_ps(_mm256_add_ps(base, _mm256_mul_ps(slope, c)), c);
+    return _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(scale, value)), _mm256_set1_epi32(0xff));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i crt8Avx2(__m256i pixels, __m256i dest, __m256 base, __m256 slope){
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+
+    __m256i r = crtChannelAvx2(_mm256_and_si256(pixels, channelMask), base, slope);
+    __m256i g = crtChannelAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask), base, slope);
+    __m256i b = crtChannelAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask), base, slope);
+
+    __m256i result = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+    result = _mm256_or_si256(result, _mm256_slli_epi32(b, 16));
+    return _mm256_or_si256(result, _mm256_and_si256(dest, alphaMask));
+}
+
+__attribute__((target("avx2")))
+static void crtAvx2(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, bool highLine, float brightboost, float intensity){
+    __m256 base = _mm256_set1_ps(highLine ? (1.0f + brightboost) : (1.0f - intensity));
+    __m256 slope = _mm256_set1_ps(highLine ? -0.2f : 0.1f);
+    int i = 0;
+    for(; i + 16 <= numPixels; i += 16){
+        const __m256i* src = (const __m256i*)(sourceImageCopy + i*4);
+        __m256i* dst = (__m256i*)(imageData + i*4);
+        __m256i a = crt8Avx2(_mm256_loadu_si256(src), _mm256_loadu_si256(dst), base, slope);
+        __m256i b = crt8Avx2(_mm256_loadu_si256(src + 1), _mm256_loadu_si256(dst + 1), base, slope);
+        _mm256_storeu_si256(dst, a);
+        _mm256_storeu_si256(dst + 1, b);
+    }
+    crtSse2(imageData + i*4, sourceImageCopy + i*4, numPixels - i, highLine, brightboost, intensity);
+}
+
+// sse2 has no gather, so lookups only get a vector version here
+__attribute__((target("avx2")))
+static void lookupAvx2(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, const int* table){
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+    int i = 0;
+    for(; i + 8 <= numPixels; i += 8){
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(sourceImageCopy + i*4));
+        __m256i* dst = (__m256i*)(imageData + i*4);
+
+        __m256i r = _mm256_i32gather_epi32(table, _mm256_and_si256(pixels, channelMask), 4);
+        __m256i g = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask), 4);
+        __m256i b = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask), 4);
+
+        __m256i result = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+        result = _mm256_or_si256(result, _mm256_slli_epi32(b, 16));
+        result = _mm256_or_si256(result, _mm256_and_si256(_mm256_loadu_si256(dst), alphaMask));
+        _mm256_storeu_si256(dst, result);
+    }
+    lookupScalar(imageData + i*4, sourceImageCopy + i*4, numPixels - i, table);
+}
+#endif
+
+void grayscalePixels(unsigned char* pixelData, int numPixels){
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            grayscaleAvx2(pixelData, numPixels);
+            break;
+        case SimdLevel::Sse2:
+            grayscaleSse2(pixelData, numPixels);
+            break;
+#endif
+        default:
+            grayscaleScalar(pixelData, numPixels);
+    }
+}
+
+void invertPixels(unsigned char* pixelData, int numPixels){
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            invertAvx2(pixelData, numPixels);
+            break;
+        case SimdLevel::Sse2:
+            invertSse2(pixelData, numPixels);
+            break;
+#endif
+        default:
+            invertScalar(pixelData, numPixels);
+    }
+}
+
+void saturatePixels(unsigned char* pixelData, int numPixels, float r1, float g1, float b1, float r2, float g2, float b2){
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            saturateAvx2(pixelData, numPixels, r1, g1, b1, r2, g2, b2);
+            break;
+        case SimdLevel::Sse2:
+            saturateSse2(pixelData, numPixels, r1, g1, b1, r2, g2, b2);
+            break;
+#endif
+        default:
+            saturateScalar(pixelData, numPixels, r1, g1, b1, r2, g2, b2);
+    }
+}
+
+void crtPixels(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, bool highLine, float brightboost, float intensity){
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            crtAvx2(imageData, sourceImageCopy, numPixels, highLine, brightboost, intensity);
+            break;
+        case SimdLevel::Sse2:
+            crtSse2(imageData, sourceImageCopy, numPixels, highLine, brightboost, intensity);
+            break;
+#endif
+        default:
+            crtScalar(imageData, sourceImageCopy, numPixels, highLine, brightboost, intensity);
+    }
+}
+
+void lookupPixels(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, const int* table){
+    switch(getSimdLevel()){
+#if SIMD_X86
+        case SimdLevel::Avx2:
+            lookupAvx2(imageData, sourceImageCopy, numPixels, table);
+            break;
+#endif
+        default:
+            lookupScalar(imageData, sourceImageCopy, numPixels, table);
+    }
+}
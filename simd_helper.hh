@@ -0,0 +1,59 @@
+#ifndef SIMD_HELPER_H
+#define SIMD_HELPER_H
+
+/***
+
+    vectorized versions of the point-wise color filters (grayscale, invert, saturate, crt)
+    and of applying a per-channel lookup table
+
+    each function works on a run of numPixels rgba pixels and picks an SSE2 or AVX2
+    version at runtime, falling back to plain loops on other cpus. the results are the
+    same as the scalar loops they replace (alpha is left alone).
+
+***/
+#include <string>
+
+// the vector versions need gcc/clang style target attributes and an x86 cpu.
+// everywhere else only the scalar loops get built
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+enum SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+// the best level this cpu supports
+SimdLevel getSupportedSimdLevel();
+
+// use a lower level than the best supported one (e.g. for comparing against Scalar).
+// levels the cpu doesn't support get lowered to what it does
+void setSimdLevel(SimdLevel level);
+SimdLevel getSimdLevel();
+
+const char* getSimdLevelName(SimdLevel level);
+bool getSimdLevelByName(const std::string& name, SimdLevel& level);
+
+// channel = (r+g+b)/3
+void grayscalePixels(unsigned char* pixelData, int numPixels);
+
+// channel = 255 - channel
+void invertPixels(unsigned char* pixelData, int numPixels);
+
+// newR = r*r1 + g*g2 + b*b2, newG = r*r2 + g*g1 + b*b2, newB = r*r2 + g*g2 + b*b1, clamped to 0-255
+void saturatePixels(unsigned char* pixelData, int numPixels, float r1, float g1, float b1, float r2, float g2, float b2);
+
+// one run of a crt scan line: each channel c (0-1) of src becomes
+// ((1 + brightboost) - 0.2c)c if highLine, otherwise ((1 - intensity) + 0.1c)c
+void crtPixels(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, bool highLine, float brightboost, float intensity);
+
+// imageData channel = table[sourceImageCopy channel] for r, g and b. table has 256 entries from 0-255
+// (ints rather than bytes so the AVX2 version can gather from it)
+void lookupPixels(unsigned char* imageData, const unsigned char* sourceImageCopy, int numPixels, const int* table);
+
+#endif
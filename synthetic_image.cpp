@@ -0,0 +1,69 @@
+#include "synthetic_image.hh"
+
+#include <algorithm>
+
+// small LCG so the images don't depend on the platform's rand()
+static unsigned int nextRandom(unsigned int& state){
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+void generateSyntheticImage(unsigned char* imageData, int width, int height, unsigned int seed){
+    unsigned int state = seed;
+    
+    // background: diagonal gradient with a little noise
+    for(int row = 0; row < height; row++){
+        for(int col = 0; col < width; col++){
+            int idx = 4 * (row * width + col);
+            int noise = (int)(nextRandom(state) % 16) - 8;
+            imageData[idx] = (unsigned char)std::min(255, std::max(0, (255 * col) / std::max(1, width - 1) + noise));
+            imageData[idx + 1] = (unsigned char)std::min(255, std::max(0, (255 * row) / std::max(1, height - 1) + noise));
+            imageData[idx + 2] = (unsigned char)std::min(255, std::max(0, 128 + noise));
+            imageData[idx + 3] = 255;
+        }
+    }
+    
+    // solid rectangles, scaled to the image size so every size has a similar amount of edges
+    int numRects = 24;
+    for(int i = 0; i < numRects; i++){
+        int rectWidth = 1 + (int)(nextRandom(state) % (unsigned int)std::max(1, width / 6));
+        int rectHeight = 1 + (int)(nextRandom(state) % (unsigned int)std::max(1, height / 6));
+        int left = (int)(nextRandom(state) % (unsigned int)width);
+        int top = (int)(nextRandom(state) % (unsigned int)height);
+        unsigned char r = (unsigned char)nextRandom(state);
+        unsigned char g = (unsigned char)nextRandom(state);
+        unsigned char b = (unsigned char)nextRandom(state);
+        
+        for(int row = top; row < std::min(height, top + rectHeight); row++){
+            for(int col = left; col < std::min(width, left + rectWidth); col++){
+                int idx = 4 * (row * width + col);
+                imageData[idx] = r;
+                imageData[idx + 1] = g;
+                imageData[idx + 2] = b;
+            }
+        }
+    }
+    
+    // thin dark lines (a few pixels wide) like scanned line-art, for thinning and edge detection
+    int numLines = 16;
+    for(int i = 0; i < numLines; i++){
+        int thickness = 1 + (int)(nextRandom(state) % 4);
+        if(i % 2 == 0){
+            int row = (int)(nextRandom(state) % (unsigned int)height);
+            for(int r = row; r < std::min(height, row + thickness); r++){
+                for(int col = 0; col < width; col++){
+                    int idx = 4 * (r * width + col);
+                    imageData[idx] = imageData[idx + 1] = imageData[idx + 2] = 10;
+                }
+            }
+        }else{
+            int col = (int)(nextRandom(state) % (unsigned int)width);
+            for(int row = 0; row < height; row++){
+                for(int c = col; c < std::min(width, col + thickness); c++){
+                    int idx = 4 * (row * width + c);
+                    imageData[idx] = imageData[idx + 1] = imageData[idx + 2] = 10;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef SYNTHETIC_IMAGE_H
+#define SYNTHETIC_IMAGE_H
+
+/***
+
+    deterministic test images for the benchmark and the cli (no image files needed)
+    
+***/
+
+// fill imageData (4 * width * height bytes, rgba) with a smooth gradient, some solid shapes
+// with hard edges, thin dark lines and a bit of noise. the same seed always gives the same image.
+void generateSyntheticImage(unsigned char* imageData, int width, int height, unsigned int seed);
+
+#endif
@@ -1,261 +1,479 @@
 #include "thinning_helper.hh"
-#include <string>
+#include "thread_pool.hh"
 
-void binarize(unsigned char* data, int width, int height, float threshold){
-    for(int i = 0; i < height; i++){
-        for(int j = 0; j < width; j++){
-            int r = (int)data[(i * width * 4) + (j * 4)];
-            int g = (int)data[(i * width * 4) + (j * 4) + 1];
-            int b = (int)data[(i * width * 4) + (j * 4) + 2];
-            float avg = (r + g + b) / 3.0;
-            if((avg / 255.0) >= threshold){
-                // if resulting grayscale color of this pixel is >= threshold,
-                // set it to white (255)
-                data[(i * width * 4) + (j * 4)]     = 255;
-                data[(i * width * 4) + (j * 4) + 1] = 255;
-                data[(i * width * 4) + (j * 4) + 2] = 255;
-            }else{
-                // make pixel black (0)
-                data[(i * width * 4) + (j * 4)]     = 0;
-                data[(i * width * 4) + (j * 4) + 1] = 0;
-                data[(i * width * 4) + (j * 4) + 2] = 0;
-            }
-        }
-    }
-}
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
+// a pixel's 8 neighbors can be packed into a byte two ways:
+// - clockwise, in the order the connectivity test goes around them: top, top-right, right, bottom-right,
+//   bottom, bottom-left, left, top-left (bits 0-7)
+// - by position, which is what ThinningBitmap reads out of its rows: top-left, top, top-right (bits 0-2),
+//   left, right (bits 3-4), bottom-left, bottom, bottom-right (bits 5-7)
+
+// flags in the table indexed by position
+#define THINNING_CONNECTED 1 // exactly one white -> black step going around the neighbors
+#define THINNING_ERASABLE 2  // connected and 2-6 black neighbors
 
-bool checkBlackNeighbors(unsigned char* data, int dataLength, int i, int j, int width){
-    int left = (4 * i * width) + ((j - 1) * 4);
-    int right = (4 * i * width) + ((j + 1) * 4);
-    int top = (4 * (i - 1) * width) + (j * 4);
-    int bottom = (4 * (i + 1) * width) + (j * 4);
-    int topLeft = (4 * (i - 1) * width) + ((j - 1) * 4);
-    int topRight = (4 * (i - 1) * width) + ((j + 1) * 4);
-    int bottomLeft = (4 * (i + 1) * width) + ((j - 1) * 4);
-    int bottomRight = (4 * (i + 1) * width) + ((j + 1) * 4);
+// flags in the zhang-suen table (also indexed by position): erasable in the first/second subiteration
+#define ZHANG_SUEN_FIRST 1
+#define ZHANG_SUEN_SECOND 2
+
+// position bit of each clockwise neighbor
+static const int clockwiseNeighborBits[8] = {1, 2, 4, 7, 6, 5, 3, 0};
+
+struct NeighborhoodTable {
+    unsigned char steps[256]; // white -> black steps going around the neighbors, indexed clockwise
+    unsigned char flags[256]; // indexed by position
+    unsigned char zhangSuen[256]; // indexed by position
     
-    // assume rgb channel values should be the same
-    // so we don't need to look at g and b
-    int numBlackNeighbors = 0;
-    if(left >= 0){
-        if((int)data[left] == 0){
-            numBlackNeighbors++;
+    NeighborhoodTable(){
+        for(int n = 0; n < 256; n++){
+            steps[n] = 0;
+            for(int k = 0; k < 8; k++){
+                bool black = (n >> k) & 1;
+                bool prevBlack = (n >> ((k + 7) % 8)) & 1;
+                steps[n] += (black && !prevBlack);
+            }
         }
-    }
-    if(right < dataLength){
-        if((int)data[right] == 0){
-            numBlackNeighbors++;
+        
+        for(int n = 0; n < 256; n++){
+            int clockwise = 0;
+            for(int k = 0; k < 8; k++){
+                clockwise |= ((n >> clockwiseNeighborBits[k]) & 1) << k;
+            }
+            int numBlack = (int)std::bitset<8>(n).count();
+            
+            flags[n] = 0;
+            if(steps[clockwise] == 1){
+                flags[n] |= THINNING_CONNECTED;
+                if(numBlack >= 2 && numBlack <= 6){
+                    flags[n] |= THINNING_ERASABLE;
+                }
+            }
+            
+            // zhang-suen has the same connectivity and neighbor count tests, then the first subiteration
+            // keeps pixels with top, right and bottom or right, bottom and left black, and the second
+            // ones with top, right and left or top, bottom and left black
+            bool top = n & 2;
+            bool left = n & 8;
+            bool right = n & 16;
+            bool bottom = n & 64;
+            zhangSuen[n] = 0;
+            if(flags[n] & THINNING_ERASABLE){
+                if(!(top && right && bottom) && !(right && bottom && left)){
+                    zhangSuen[n] |= ZHANG_SUEN_FIRST;
+                }
+                if(!(top && right && left) && !(top && bottom && left)){
+                    zhangSuen[n] |= ZHANG_SUEN_SECOND;
+                }
+            }
         }
     }
-    if(top >= 0){
-        if((int)data[top] == 0){
-            numBlackNeighbors++;
-        }
+};
+
+static const NeighborhoodTable neighborhoodTable;
+
+// white -> black steps going around the neighbors set in present (clockwise bits).
+// missing neighbors are left out of the sequence rather than counted as white, so if any are
+// missing the sequence doesn't wrap around from the last neighbor back to the first
+static int countConnectivitySteps(int black, int present){
+    if(present == 0xff){
+        return neighborhoodTable.steps[black];
     }
-    if(bottom < dataLength){
-        if((int)data[bottom] == 0){
-            numBlackNeighbors++;
+    
+    // the sequence starts and ends at the top neighbor
+    int numSteps = 0;
+    int prev = -1; // -1 until the first neighbor that's there
+    for(int k = 0; k <= 8; k++){
+        if(!((present >> (k % 8)) & 1)){
+            continue;
         }
-    }
-    if(topLeft >= 0){
-        if((int)data[topLeft] == 0){
-            numBlackNeighbors++;
+        int curr = (black >> (k % 8)) & 1;
+        if(prev == 0 && curr == 1){
+            numSteps++;
         }
+        prev = curr;
     }
-    if(topRight >= 0){
-        if((int)data[topRight] == 0){
-            numBlackNeighbors++;
-        }
+    return numSteps;
+}
+
+// the 64 bits starting at bit
+static inline uint64_t readBits(const uint64_t* words, long long bit){
+    long long word = bit >> 6;
+    int shift = (int)(bit & 63);
+    return shift == 0 ? words[word] : (words[word] >> shift) | (words[word + 1] << (64 - shift));
+}
+
+static inline bool isBlackBit(const ThinningBitmap& bitmap, long long p){
+    if(p < 0 || p >= bitmap.numPixels){
+        return false;
     }
-    if(bottomLeft < dataLength){
-        if((int)data[bottomLeft] == 0){
-            numBlackNeighbors++;
-        }
+    long long bit = p + bitmap.padding;
+    return (bitmap.pixels[bit >> 6] >> (bit & 63)) & 1;
+}
+
+// the connectivity test for pixels with some neighbors missing, which are left out of the
+// sequence rather than counted as white
+static bool testConnectivityAtEdge(const ThinningBitmap& bitmap, long long p){
+    if(!isBlackBit(bitmap, p)){
+        return false;
     }
-    if(bottomRight < dataLength){
-        if((int)data[bottomRight] == 0){
-            numBlackNeighbors++;
+    
+    long long w = bitmap.width;
+    long long neighbors[8] = {p - w, p - w + 1, p + 1, p + w + 1, p + w, p + w - 1, p - 1, p - w - 1};
+    
+    int black = 0;
+    int present = 0;
+    for(int k = 0; k < 8; k++){
+        if(neighbors[k] >= 0 && neighbors[k] < bitmap.numPixels){
+            present |= 1 << k;
+            black |= (int)isBlackBit(bitmap, neighbors[k]) << k;
         }
     }
     
-    return numBlackNeighbors >= 2 && numBlackNeighbors <= 6;
+    return countConnectivitySteps(black, present) == 1;
 }
 
-bool testConnectivity(unsigned char* data, int dataLength, int i, int j, int width){
+static inline int countTrailingZeros(uint64_t bits){
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while(!(bits & 1)){
+        bits >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// look up the neighborhoods of the pixels set in black (bit k for pixel p + k, 32 pixels) in the table
+// and set their bits in connected and erasable
+static inline void lookupNeighborhoods(const ThinningBitmap& bitmap, long long p, uint64_t black, uint64_t& connected, uint64_t& erasable){
+    const uint64_t* pixels = bitmap.pixels.data();
+    long long bit = p + bitmap.padding;
+    uint64_t above = readBits(pixels, bit - bitmap.width - 1);
+    uint64_t middle = readBits(pixels, bit - 1);
+    uint64_t below = readBits(pixels, bit + bitmap.width - 1);
     
-    if(i < 0 || j < 0){
-        return false;
+    connected = 0;
+    erasable = 0;
+    while(black){
+        int k = countTrailingZeros(black);
+        black &= black - 1;
+        
+        int neighborhood = (int)((above >> k) & 7) |
+                           (int)(((middle >> k) & 1) | ((middle >> (k + 1)) & 2)) << 3 |
+                           (int)((below >> k) & 7) << 5;
+        unsigned char flags = neighborhoodTable.flags[neighborhood];
+        connected |= (uint64_t)(flags & THINNING_CONNECTED) << k;
+        erasable |= (uint64_t)((flags & THINNING_ERASABLE) >> 1) << k;
     }
+}
+
+void packBinarized(ThinningBitmap& bitmap, const unsigned char* data, int numPixels, int width, float threshold){
+    bitmap.width = width;
+    bitmap.numPixels = numPixels;
     
-    int left = (4 * i * width) + ((j - 1) * 4);
-    int right = (4 * i * width) + ((j + 1) * 4);
-    int top = (4 * (i - 1) * width) + (j * 4);
-    int bottom = (4 * (i + 1) * width) + (j * 4);
-    int topLeft = (4 * (i - 1) * width) + ((j - 1) * 4);
-    int topRight = (4 * (i - 1) * width) + ((j + 1) * 4);
-    int bottomLeft = (4 * (i + 1) * width) + ((j - 1) * 4);
-    int bottomRight = (4 * (i + 1) * width) + ((j + 1) * 4);
+    // whole words of white on both sides, wide enough for the neighbors a row above and below
+    bitmap.padding = 64 * ((width + 1) / 64 + 3);
+    size_t numWords = ((size_t)numPixels + 2 * bitmap.padding + 63) / 64 + 1;
+    bitmap.pixels.assign(numWords, 0);
+    bitmap.connected.assign(numWords, 0);
+    bitmap.erasable.assign(numWords, 0);
+    bitmap.next.assign(numWords, 0);
     
-    int numConnectedNeighbors = 0;
-    std::string sequence = "";
+    // everything counts as changed before the first pass
+    bitmap.changed.assign((numPixels + 63) / 64, 3);
+    bitmap.active.assign((numPixels + 63) / 64, 0);
     
-    int currPixelIdx = (4 * i * width) + (j * 4);
+    int firstWord = bitmap.padding / 64;
+    int numPixelWords = (numPixels + 63) / 64;
+    uint64_t* pixels = bitmap.pixels.data();
     
-    // don't operate on non-black pixels
-    if((int)data[currPixelIdx] != 0){
-        return false;
+    // a pixel is white when its average (r + g + b) / 3, scaled to 0-1, is at least threshold. that only
+    // depends on r + g + b, so find the smallest sum that's white once
+    int whiteSum = 0;
+    while(whiteSum <= 3 * 255){
+        float avg = whiteSum / 3.0;
+        if((avg / 255.0) >= threshold){
+            break;
+        }
+        whiteSum++;
     }
     
-    // note there is a specific sequence in which to evaluate the cells
-    // e.g. top -> top-right -> right -> bottom-right -> ... -> top in clockwise-fashion
-    if(top >= 0){
-        if((int)data[top] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+    parallelFor(0, numPixelWords, [=](int startWord, int endWord){
+        for(int word = startWord; word < endWord; word++){
+            uint64_t bits = 0;
+            for(int k = 0; k < 64 && word * 64 + k < numPixels; k++){
+                const unsigned char* pixel = data + 4 * ((long long)word * 64 + k);
+                bits |= (uint64_t)((int)pixel[0] + (int)pixel[1] + (int)pixel[2] < whiteSum) << k;
+            }
+            pixels[firstWord + word] = bits;
         }
-    }
-    if(topRight >= 0){
-        if((int)data[topRight] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+    });
+}
+
+void unpackBinarized(const ThinningBitmap& bitmap, unsigned char* data){
+    int numPixels = bitmap.numPixels;
+    int firstWord = bitmap.padding / 64;
+    int numPixelWords = (numPixels + 63) / 64;
+    const uint64_t* pixels = bitmap.pixels.data();
+    
+    parallelFor(0, numPixelWords, [=](int startWord, int endWord){
+        for(int word = startWord; word < endWord; word++){
+            uint64_t bits = pixels[firstWord + word];
+            for(int k = 0; k < 64 && word * 64 + k < numPixels; k++){
+                unsigned char* pixel = data + 4 * ((long long)word * 64 + k);
+                unsigned char value = ((bits >> k) & 1) ? 0 : 255;
+                pixel[0] = value;
+                pixel[1] = value;
+                pixel[2] = value;
+            }
         }
-    }
-    if(right < dataLength){
-        if((int)data[right] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+    });
+}
+
+// collect the words with pixels that could be affected by the ones that changed in the passes set in history
+// (bit 0 for the last pass, bit 1 for the one before), going by which pixels from firstRow to lastRow
+// rows and firstCol to lastCol columns away from a changed one depend on it
+static void findActiveWords(ThinningBitmap& bitmap, int history, int firstRow, int lastRow, int firstCol, int lastCol){
+    int numPixels = bitmap.numPixels;
+    long long width = bitmap.width;
+    int numPixelWords = (numPixels + 63) / 64;
+    
+    std::vector<unsigned char>& active = bitmap.active;
+    std::fill(active.begin(), active.end(), 0);
+    for(int word = 0; word < numPixelWords; word++){
+        if(!(bitmap.changed[word] & history)){
+            continue;
         }
-    }
-    if(bottomRight < dataLength){
-        if((int)data[bottomRight] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+        for(int row = firstRow; row <= lastRow; row++){
+            long long first = std::max(0LL, (long long)word * 64 + row * width + firstCol);
+            long long last = std::min((long long)numPixels - 1, (long long)word * 64 + 63 + row * width + lastCol);
+            for(long long w = first / 64; w <= last / 64; w++){
+                active[w] = 1;
+            }
         }
     }
-    if(bottom < dataLength){
-        if((int)data[bottom] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+    
+    bitmap.activeWords.clear();
+    for(int word = 0; word < numPixelWords; word++){
+        if(active[word]){
+            bitmap.activeWords.push_back(word);
         }
     }
-    if(bottomLeft < dataLength){
-        if((int)data[bottomLeft] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
-        }
+}
+
+// move the changed flags along by a pass, before the next one sets bit 0
+static void ageChangedWords(ThinningBitmap& bitmap){
+    for(unsigned char& changed : bitmap.changed){
+        changed = (changed << 1) & 3;
     }
-    if(left >= 0){
-        if((int)data[left] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
-        }
+}
+
+int thinningPass(ThinningBitmap& bitmap){
+    int numPixels = bitmap.numPixels;
+    long long width = bitmap.width;
+    int firstWord = bitmap.padding / 64;
+    
+    // whether a pixel gets erased only depends on the pixels from two rows above it to one row below,
+    // and from one column left of it to two columns right (its own neighbors and those of the pixels
+    // above and to the right). so only words that close to one that changed last pass can turn out
+    // any differently this time
+    findActiveWords(bitmap, 1, -1, 2, -2, 1);
+    const std::vector<unsigned char>& active = bitmap.active;
+    const std::vector<int>& activeWords = bitmap.activeWords;
+    int numActive = (int)activeWords.size();
+    if(numActive == 0){
+        return 0;
     }
-    if(topLeft >= 0){
-        if((int)data[topLeft] == 255){
-            sequence += "0";
-        }else{
-            sequence += "1";
+    
+    // mask of the real pixels in word
+    auto pixelMask = [numPixels](int word){
+        int numBits = std::min(64, numPixels - word * 64);
+        return numBits == 64 ? ~(uint64_t)0 : (((uint64_t)1 << numBits) - 1);
+    };
+    
+    // first which black pixels are connected, since the line checks need that for the pixels above
+    // and to the right, and which are erasable too
+    parallelFor(0, numActive, [&](int start, int end){
+        for(int i = start; i < end; i++){
+            int word = activeWords[i];
+            uint64_t pixels = bitmap.pixels[firstWord + word] & pixelMask(word);
+            uint64_t connected = 0;
+            uint64_t erasable = 0;
+            if(pixels){
+                long long p = (long long)word * 64;
+                uint64_t connectedHigh;
+                uint64_t erasableHigh;
+                lookupNeighborhoods(bitmap, p, pixels & 0xffffffff, connected, erasable);
+                lookupNeighborhoods(bitmap, p + 32, pixels >> 32, connectedHigh, erasableHigh);
+                connected |= connectedHigh << 32;
+                erasable |= erasableHigh << 32;
+            }
+            bitmap.connected[firstWord + word] = connected;
+            bitmap.erasable[firstWord + word] = erasable;
         }
-    }
-    if(top >= 0){
-        if((int)data[top] == 255){
-            sequence += "0";
+    });
+    
+    // pixels on the first and last rows (give or take one) are missing some neighbors, which
+    // the table can't account for in the connectivity test. those get redone the slow way
+    long long edgeEnd = std::min((long long)numPixels, width + 1);
+    long long edgeStart = std::max(edgeEnd, (long long)numPixels - width - 1);
+    auto setBit = [&bitmap](std::vector<uint64_t>& words, long long p, bool value){
+        long long bit = p + bitmap.padding;
+        if(value){
+            words[bit >> 6] |= (uint64_t)1 << (bit & 63);
         }else{
-            sequence += "1";
+            words[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+        }
+    };
+    auto redoEdgePixel = [&](long long p){
+        if(!active[p / 64]){
+            return;
         }
+        
+        // the table's black neighbor count is still right, since missing neighbors count as white there
+        long long bit = p + bitmap.padding;
+        int neighborhood = (int)(readBits(bitmap.pixels.data(), bit - width - 1) & 7) |
+                           (int)((readBits(bitmap.pixels.data(), bit - 1) & 1) | (readBits(bitmap.pixels.data(), bit) & 2)) << 3 |
+                           (int)(readBits(bitmap.pixels.data(), bit + width - 1) & 7) << 5;
+        int numBlack = (int)std::bitset<8>(neighborhood).count();
+        
+        bool connected = testConnectivityAtEdge(bitmap, p);
+        setBit(bitmap.connected, p, connected);
+        setBit(bitmap.erasable, p, connected && numBlack >= 2 && numBlack <= 6);
+    };
+    for(long long p = 0; p < edgeEnd; p++){
+        redoEdgePixel(p);
     }
+    for(long long p = edgeStart; p < numPixels; p++){
+        redoEdgePixel(p);
+    }
+    
+    // then erase black pixels that are erasable themselves, unless the pixel above or to the right is
+    // black and connected (that's what the vertical and horizontal line checks come down to)
+    std::copy(bitmap.pixels.begin(), bitmap.pixels.end(), bitmap.next.begin());
+    ageChangedWords(bitmap);
     
-    // evaluate sequence generated
-    // we're looking for susbtrings with "01"
-    for(int i = 0; i < sequence.length() - 1; i++){
-        if(sequence[i] == '0' && sequence[i+1] == '1'){
-            numConnectedNeighbors++;
+    std::atomic<int> numErased(0);
+    parallelFor(0, numActive, [&](int start, int end){
+        int erased = 0;
+        for(int i = start; i < end; i++){
+            int word = activeWords[i];
+            uint64_t pixels = bitmap.pixels[firstWord + word];
+            uint64_t erase = pixels & bitmap.erasable[firstWord + word];
+            if(erase){
+                long long bit = (long long)word * 64 + bitmap.padding;
+                erase &= ~readBits(bitmap.connected.data(), bit - width) & ~readBits(bitmap.connected.data(), bit + 1);
+            }
+            if(erase){
+                bitmap.next[firstWord + word] = pixels & ~erase;
+                bitmap.changed[word] |= 1;
+                erased += (int)std::bitset<64>(erase).count();
+            }
         }
-    }
+        numErased += erased;
+    });
     
-    return numConnectedNeighbors == 1;
+    bitmap.pixels.swap(bitmap.next);
+    return numErased;
 }
 
-bool verticalLineCheck(unsigned char* data, int dataLength, int i, int j, int width){
-    int left = (4 * i * width) + ((j - 1) * 4);
-    int right = (4 * i * width) + ((j + 1) * 4);
-    int top = (4 * (i - 1) * width) + (j * 4);
-    
-    int numConnectedNeighbors = 0;
-    if(left >= 0){
-        if((int)data[left] != 0){
-            numConnectedNeighbors++;
-        }
-    }
-    if(right < dataLength){
-        if((int)data[right] != 0){
-            numConnectedNeighbors++;
-        }
+// bit k set for the pixels p + k (of 64) that are in the first column of a row
+static inline uint64_t firstColumnMask(long long p, int width){
+    uint64_t mask = 0;
+    for(long long k = (width - p % width) % width; k < 64; k += width){
+        mask |= (uint64_t)1 << k;
     }
-    if(top >= 0){
-        if((int)data[top] != 0){
-            numConnectedNeighbors++;
-        }
-    }
-    
-    return numConnectedNeighbors == 3 || !testConnectivity(data, dataLength, i-1, j, width);
+    return mask;
 }
 
-bool horizontalLineCheck(unsigned char* data, int dataLength, int i, int j, int width){
-    int bottom = (4 * (i + 1) * width) + (j * 4);
-    int right = (4 * i * width) + ((j + 1) * 4);
-    int top = (4 * (i - 1) * width) + (j * 4);
+// which of the pixels set in black (bit k for pixel p + k, 32 pixels) can be erased in the given
+// zhang-suen subiteration. firstColumn and lastColumn mark the pixels at the ends of their rows,
+// whose neighbors on that side are outside the image rather than on the next/previous row
+static inline uint64_t lookupZhangSuen(const ThinningBitmap& bitmap, long long p, uint64_t black, uint64_t firstColumn, uint64_t lastColumn, int subiteration){
+    const uint64_t* pixels = bitmap.pixels.data();
+    long long bit = p + bitmap.padding;
+    uint64_t above = readBits(pixels, bit - bitmap.width - 1);
+    uint64_t middle = readBits(pixels, bit - 1);
+    uint64_t below = readBits(pixels, bit + bitmap.width - 1);
     
-    int numConnectedNeighbors = 0;
-    if(bottom < dataLength){
-        if((int)data[bottom] != 0){
-            numConnectedNeighbors++;
+    uint64_t erase = 0;
+    while(black){
+        int k = countTrailingZeros(black);
+        black &= black - 1;
+        
+        int neighborhood = (int)((above >> k) & 7) |
+                           (int)(((middle >> k) & 1) | ((middle >> (k + 1)) & 2)) << 3 |
+                           (int)((below >> k) & 7) << 5;
+        if((firstColumn >> k) & 1){
+            neighborhood &= ~(1 | 8 | 32); // top-left, left, bottom-left
         }
-    }
-    if(right < dataLength){
-        if((int)data[right] != 0){
-            numConnectedNeighbors++;
-        }
-    }
-    if(top >= 0){
-        if((int)data[top] != 0){
-            numConnectedNeighbors++;
+        if((lastColumn >> k) & 1){
+            neighborhood &= ~(4 | 16 | 128); // top-right, right, bottom-right
         }
+        erase |= (uint64_t)((neighborhoodTable.zhangSuen[neighborhood] & subiteration) != 0) << k;
     }
-    
-    return numConnectedNeighbors == 3 || !testConnectivity(data, dataLength, i, j+1, width);
+    return erase;
 }
 
-bool hasEightNeighbors(unsigned char* data, int dataLength, int i, int j, int width){
-    int left = (4 * i * width) + ((j - 1) * 4);
-    int right = (4 * i * width) + ((j + 1) * 4);
-    int top = (4 * (i - 1) * width) + (j * 4);
-    int bottom = (4 * (i + 1) * width) + (j * 4);
-    int topLeft = (4 * (i - 1) * width) + ((j - 1) * 4);
-    int topRight = (4 * (i - 1) * width) + ((j + 1) * 4);
-    int bottomLeft = (4 * (i + 1) * width) + ((j - 1) * 4);
-    int bottomRight = (4 * (i + 1) * width) + ((j + 1) * 4);
+// one zhang-suen subiteration from bitmap.pixels into bitmap.next, then swapped back
+static int zhangSuenSubiteration(ThinningBitmap& bitmap, int subiteration){
+    int numPixels = bitmap.numPixels;
+    int width = bitmap.width;
+    int firstWord = bitmap.padding / 64;
+    
+    // a pixel only depends on its own neighbors, but the two subiterations test them differently, so
+    // anything near a change from either of the last two subiterations needs looking at again
+    findActiveWords(bitmap, 3, -1, 1, -1, 1);
+    const std::vector<int>& activeWords = bitmap.activeWords;
+    int numActive = (int)activeWords.size();
+    
+    std::copy(bitmap.pixels.begin(), bitmap.pixels.end(), bitmap.next.begin());
+    ageChangedWords(bitmap);
+    if(numActive == 0){
+        return 0;
+    }
+    
+    // every pixel is decided from bitmap.pixels and written to bitmap.next, so the words can be split
+    // between threads in any order
+    std::atomic<int> numErased(0);
+    parallelFor(0, numActive, [&](int start, int end){
+        int erased = 0;
+        for(int i = start; i < end; i++){
+            int word = activeWords[i];
+            long long p = (long long)word * 64;
+            int numBits = std::min(64, numPixels - word * 64);
+            uint64_t pixelMask = numBits == 64 ? ~(uint64_t)0 : (((uint64_t)1 << numBits) - 1);
+            uint64_t pixels = bitmap.pixels[firstWord + word];
+            if(!(pixels & pixelMask)){
+                continue;
+            }
+            
+            uint64_t firstColumn = firstColumnMask(p, width);
+            uint64_t lastColumn = firstColumnMask(p + 1, width);
+            uint64_t low = pixels & pixelMask & 0xffffffff;
+            uint64_t high = (pixels & pixelMask) >> 32;
+            uint64_t erase = lookupZhangSuen(bitmap, p, low, firstColumn, lastColumn, subiteration) |
+                             lookupZhangSuen(bitmap, p + 32, high, firstColumn >> 32, lastColumn >> 32, subiteration) << 32;
+            if(erase){
+                bitmap.next[firstWord + word] = pixels & ~erase;
+                bitmap.changed[word] |= 1;
+                erased += (int)std::bitset<64>(erase).count();
+            }
+        }
+        numErased += erased;
+    });
     
-    return (
-        (left >= 0 && left < dataLength) &&
-        (right >= 0 && right < dataLength) &&
-        (top >= 0 && top < dataLength) &&
-        (bottom >= 0 && bottom < dataLength) &&
-        (topLeft >= 0 && topLeft < dataLength) &&
-        (topRight >= 0 && topRight < dataLength) &&
-        (bottomLeft >= 0 && bottomLeft < dataLength) &&
-        (bottomRight >= 0 && bottomRight < dataLength)
-    );
+    bitmap.pixels.swap(bitmap.next);
+    return numErased;
 }
 
-bool isBlackPixel(unsigned char* data, int i, int j, int width){
-    int idx = (4 * i * width) + (j * 4);
-    return data[idx] == 0;
+int zhangSuenPass(ThinningBitmap& bitmap){
+    int numErased = zhangSuenSubiteration(bitmap, ZHANG_SUEN_FIRST);
+    numErased += zhangSuenSubiteration(bitmap, ZHANG_SUEN_SECOND);
+    return numErased;
 }
@@ -3,13 +3,47 @@
 #define THINNING_HELPER_H
 
 #include <iostream>
+#include <cstdint>
+#include <vector>
 
-void binarize(unsigned char* data, int width, int height, float threshold);
-bool checkBlackNeighbors(unsigned char* data, int dataLength, int i, int j, int width);
-bool testConnectivity(unsigned char* data, int dataLength, int i, int j, int width);
-bool verticalLineCheck(unsigned char* data, int dataLength, int i, int j, int width);
-bool horizontalLineCheck(unsigned char* data, int dataLength, int i, int j, int width);
-bool hasEightNeighbors(unsigned char* data, int dataLength, int i, int j, int width);
-bool isBlackPixel(unsigned char* data, int i, int j, int width);
+// black/white image packed 1 bit per pixel (1 = black) for thinning.
+// pixels are numbered p = row * width + col like in the rgba data, and neighbors are found by index
+// (p - 1, p + 1, p - width, ...) like the original filter does, so the pixel after the end of a row is
+// the first one of the next row. pixels before the first one and after the last one count as missing
+struct ThinningBitmap {
+    int width = 0;
+    int numPixels = 0;
+    int padding = 0;                // bits of white before and after the image, so looking up neighbors never goes out of bounds
+    std::vector<uint64_t> pixels;
+    
+    // kept between passes by thinningPass
+    std::vector<uint64_t> connected;  // black pixels with exactly one white -> black step going clockwise around their neighbors
+    std::vector<uint64_t> erasable;   // connected black pixels with 2-6 black neighbors
+    std::vector<unsigned char> changed; // words of pixels that had something erased in the last pass (bit 0) or the one before (bit 1)
+    
+    // scratch for thinningPass
+    std::vector<uint64_t> next;
+    std::vector<unsigned char> active; // words near ones that changed
+    std::vector<int> activeWords;
+};
+
+// binarize data (numPixels rgba pixels) into the bitmap: pixels whose average of r, g and b (scaled to 0-1)
+// is below threshold are black
+void packBinarized(ThinningBitmap& bitmap, const unsigned char* data, int numPixels, int width, float threshold);
+
+// write the bitmap back as black (0) and white (255) rgb. alpha is left alone
+void unpackBinarized(const ThinningBitmap& bitmap, unsigned char* data);
+
+// one hilditch pass: erase every black pixel that's erasable, unless the pixel above or the one to the
+// right is black and connected (all tested against the bitmap as it was before the pass).
+// only the parts of the image near pixels erased by the last pass get looked at again.
+// returns how many pixels were erased (once that's 0, further passes won't change anything)
+int thinningPass(ThinningBitmap& bitmap);
+
+// one zhang-suen iteration (both subiterations). unlike thinningPass every pixel only depends on the
+// bitmap from before the subiteration, so it splits across threads without changing the result.
+// pixels past the ends of a row count as white here rather than wrapping around to the next row.
+// returns how many pixels were erased
+int zhangSuenPass(ThinningBitmap& bitmap);
 
 #endif
\ No newline at end of file
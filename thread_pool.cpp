@@ -0,0 +1,157 @@
+#include "thread_pool.hh"
+
+#include <algorithm>
+
+// split each parallelFor into a few chunks per thread so a slow chunk can be balanced out by stealing
+#define CHUNKS_PER_THREAD 4
+
+ThreadPool::ThreadPool(int numThreads) : queuedTasks(0), nextQueue(0), stopping(false){
+    if(numThreads <= 0){
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    for(int i = 0; i < numThreads - 1; i++){
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for(int i = 0; i < numThreads - 1; i++){
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+
+    for(std::thread& t : workers){
+        t.join();
+    }
+}
+
+int ThreadPool::getNumThreads() const {
+    return (int)workers.size() + 1;
+}
+
+bool ThreadPool::runQueuedTask(int queueIndex){
+    int numQueues = (int)queues.size();
+    std::function<void()> task;
+
+    for(int i = 0; i < numQueues && !task; i++){
+        WorkQueue& queue = *queues[(queueIndex + i) % numQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()){
+            continue;
+        }
+        if(i == 0){
+            // own queue: newest first
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }else{
+            // someone else's: steal the oldest
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if(!task){
+        return false;
+    }
+
+    queuedTasks--;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int queueIndex){
+    while(true){
+        if(runQueuedTask(queueIndex)){
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeWorkers.wait(lock, [this]{ return stopping || queuedTasks > 0; });
+        if(stopping){
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& func){
+    int count = end - begin;
+    if(count <= 0){
+        return;
+    }
+
+    int numChunks = std::min(count, getNumThreads() * CHUNKS_PER_THREAD);
+    if(workers.empty() || numChunks == 1){
+        func(begin, end);
+        return;
+    }
+
+    // shared with the tasks so it stays alive until the last one is done with it,
+    // even if this call has already returned
+    struct Batch {
+        std::atomic<int> remaining;
+        std::mutex doneMutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining = numChunks;
+
+    // spread the chunks over the worker queues
+    int numQueues = (int)queues.size();
+    unsigned int firstQueue = nextQueue++;
+    for(int i = 0; i < numChunks; i++){
+        int start = begin + (int)((long long)count * i / numChunks);
+        int stop = begin + (int)((long long)count * (i + 1) / numChunks);
+
+        WorkQueue& queue = *queues[(firstQueue + i) % numQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back([&func, batch, start, stop]{
+            func(start, stop);
+            std::lock_guard<std::mutex> doneLock(batch->doneMutex);
+            if(--batch->remaining == 0){
+                batch->done.notify_all();
+            }
+        });
+        queuedTasks++;
+    }
+
+    {
+        // lock so a worker can't miss the wakeup between checking queuedTasks and waiting
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeWorkers.notify_all();
+
+    // help out until there's nothing left to take, then wait for chunks still running elsewhere
+    while(batch->remaining > 0 && runQueuedTask(firstQueue % numQueues));
+
+    std::unique_lock<std::mutex> lock(batch->doneMutex);
+    batch->done.wait(lock, [&batch]{ return batch->remaining == 0; });
+}
+
+static std::unique_ptr<ThreadPool> sharedPool;
+static std::mutex sharedPoolMutex;
+
+ThreadPool& getThreadPool(){
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    if(!sharedPool){
+        sharedPool.reset(new ThreadPool(0));
+    }
+    return *sharedPool;
+}
+
+void setThreadCount(int numThreads){
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    sharedPool.reset(new ThreadPool(numThreads));
+}
+
+int getThreadCount(){
+    return getThreadPool().getNumThreads();
+}
+
+void parallelFor(int begin, int end, const std::function<void(int, int)>& func){
+    getThreadPool().parallelFor(begin, end, func);
+}
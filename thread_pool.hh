@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/***
+
+    work-stealing thread pool for splitting filters across rows (or any other range)
+
+    each worker has its own queue and takes work from the back of it, and when it runs out
+    it steals from the front of the other workers' queues. the thread calling parallelFor
+    helps out too, so a pool with n threads has n-1 workers.
+
+***/
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    public:
+        // numThreads includes the calling thread. 0 means one per hardware thread
+        explicit ThreadPool(int numThreads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int getNumThreads() const;
+
+        // call func(start, end) over chunks of [begin, end) and wait for all of them to finish.
+        // several threads can call this at the same time
+        void parallelFor(int begin, int end, const std::function<void(int, int)>& func);
+
+    private:
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> queues; // one per worker
+        std::vector<std::thread> workers;
+        std::atomic<int> queuedTasks;
+        std::atomic<unsigned int> nextQueue;
+        std::mutex sleepMutex;
+        std::condition_variable wakeWorkers;
+        bool stopping;
+
+        void workerLoop(int queueIndex);
+
+        // run one queued task, starting with queueIndex and then stealing from the others.
+        // returns false if there was nothing to do
+        bool runQueuedTask(int queueIndex);
+};
+
+// the pool shared by the filters
+ThreadPool& getThreadPool();
+
+// change the number of threads in the shared pool (0 = one per hardware thread).
+// don't call this while a filter is running
+void setThreadCount(int numThreads);
+
+int getThreadCount();
+
+// parallelFor on the shared pool
+void parallelFor(int begin, int end, const std::function<void(int, int)>& func);
+
+#endif
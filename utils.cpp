@@ -1,9 +1,11 @@
 #include "utils.hh"
+#include "thread_pool.hh"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -22,9 +24,10 @@
 
 #define FILEPATH_MAX_LENGTH 260
 
-#define TEMP_IMAGE GL_TEXTURE1
 #define IMAGE_DISPLAY GL_TEXTURE2
-#define ORIGINAL_IMAGE GL_TEXTURE3
+
+// how long (in ms) applying a filter to every frame of a gif gets to work in between ui frames
+#define GIF_BATCH_STEP_MS 30
 
 std::string trimString(std::string& str){
     std::string trimmed("");
@@ -45,7 +48,7 @@ std::string colorText(int r, int g, int b){
 
 
 // https://github.com/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples
-bool importImage(const char* filename, GLuint* tex, GLuint* originalImage, int* width, int* height, int* channels){
+bool importImage(const char* filename, ImageDocument& imageDoc, int* channels){
     int imageWidth = 0;
     int imageHeight = 0;
     int imageChannels = 4;
@@ -57,11 +60,40 @@ bool importImage(const char* filename, GLuint* tex, GLuint* originalImage, int*
         return false;
     }
     
-    // the current image texture
-    glActiveTexture(IMAGE_DISPLAY);
-    GLuint imageTexture;
-    glGenTextures(1, &imageTexture);
-    glBindTexture(GL_TEXTURE_2D, imageTexture);
+    loadImageDocument(imageDoc, imageData, imageWidth, imageHeight);
+    
+    // upload right away so the texture exists before it gets drawn
+    uploadDisplayTexture(imageDoc);
+    
+    stbi_image_free(imageData);
+    
+    *channels = imageChannels;
+    
+    return true;
+}
+
+// replace the original, temp and display images with imageData
+void loadImageDocument(ImageDocument& imageDoc, const unsigned char* imageData, int width, int height){
+    int pixelDataLen = width * height * 4;
+    
+    imageDoc.width = width;
+    imageDoc.height = height;
+    imageDoc.originalWidth = width;
+    imageDoc.originalHeight = height;
+    
+    imageDoc.original.assign(imageData, imageData + pixelDataLen);
+    imageDoc.temp.assign(imageData, imageData + pixelDataLen);
+    imageDoc.display.assign(imageData, imageData + pixelDataLen);
+    imageDoc.displayDirty = true;
+}
+
+// (re)create the display texture with storage for the current image size.
+// immutable storage can't be resized, so a new size means a new texture
+static void allocateDisplayTexture(ImageDocument& imageDoc){
+    releaseDisplayTexture(imageDoc);
+    
+    glGenTextures(1, &imageDoc.displayTexture);
+    glBindTexture(GL_TEXTURE_2D, imageDoc.displayTexture);
     
     // TODO: understand this stuff
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -69,46 +101,88 @@ bool importImage(const char* filename, GLuint* tex, GLuint* originalImage, int*
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
     
-    #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    #endif
+    if(GLEW_VERSION_4_2 || GLEW_ARB_texture_storage){
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, imageDoc.width, imageDoc.height);
+    }else{
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, imageDoc.width, imageDoc.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
     
-    // create the texture with the image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    if(GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object){
+        glGenBuffers(2, imageDoc.unpackBuffers);
+        for(GLuint buffer : imageDoc.unpackBuffers){
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, imageDoc.pixelDataLen(), NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
     
-    // store the image in another texture that we won't touch (but just read from)
-    glActiveTexture(ORIGINAL_IMAGE);
-    GLuint imageTexture2;
-    glGenTextures(1, &imageTexture2);
-    glBindTexture(GL_TEXTURE_2D, imageTexture2);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    imageDoc.textureWidth = imageDoc.width;
+    imageDoc.textureHeight = imageDoc.height;
+}
+
+void releaseDisplayTexture(ImageDocument& imageDoc){
+    if(imageDoc.unpackBuffers[0] != 0){
+        glDeleteBuffers(2, imageDoc.unpackBuffers);
+        imageDoc.unpackBuffers[0] = 0;
+        imageDoc.unpackBuffers[1] = 0;
+    }
+    if(imageDoc.displayTexture != 0){
+        glDeleteTextures(1, &imageDoc.displayTexture);
+        imageDoc.displayTexture = 0;
+    }
+    imageDoc.textureWidth = 0;
+    imageDoc.textureHeight = 0;
+}
+
+// copy the display image to its texture, but only if it changed
+void uploadDisplayTexture(ImageDocument& imageDoc){
+    if(!imageDoc.displayDirty){
+        return;
+    }
     
-    // have a texture to act as an intermediary so that successive changes (e.g. when changing parameter values for a filter)
-    // won't completely clobber the image
-    // we'll do changes on this texture for any filters that have parameters
-    glActiveTexture(TEMP_IMAGE);
-    GLuint imageTexture3;
-    glGenTextures(1, &imageTexture3);
-    glBindTexture(GL_TEXTURE_2D, imageTexture3);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    glActiveTexture(IMAGE_DISPLAY);
     
-    stbi_image_free(imageData);
+    if(imageDoc.displayTexture == 0 || imageDoc.textureWidth != imageDoc.width || imageDoc.textureHeight != imageDoc.height){
+        allocateDisplayTexture(imageDoc);
+    }else{
+        glBindTexture(GL_TEXTURE_2D, imageDoc.displayTexture);
+    }
     
-    *tex = imageTexture;
-    *originalImage = imageTexture2;
-    *width = imageWidth;
-    *height = imageHeight;
-    *channels = imageChannels;
+    #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    #endif
     
-    return true;
+    int pixelDataLen = imageDoc.pixelDataLen();
+    
+    if(imageDoc.unpackBuffers[0] != 0){
+        // stream through the two pixel buffers in turn so this copy doesn't have to
+        // wait on the driver still reading the previous upload
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, imageDoc.unpackBuffers[imageDoc.nextUnpackBuffer]);
+        imageDoc.nextUnpackBuffer = 1 - imageDoc.nextUnpackBuffer;
+        
+        // orphan the old contents so the driver can hand back fresh memory
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pixelDataLen, NULL, GL_STREAM_DRAW);
+        
+        void* mapped = NULL;
+        if(GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range){
+            mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixelDataLen, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
+        
+        if(mapped != NULL){
+            memcpy(mapped, imageDoc.display.data(), pixelDataLen);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }else{
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, pixelDataLen, imageDoc.display.data());
+        }
+        
+        // with a pixel buffer bound the last argument is an offset into it
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageDoc.width, imageDoc.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }else{
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageDoc.width, imageDoc.height, GL_RGBA, GL_UNSIGNED_BYTE, imageDoc.display.data());
+    }
+    
+    imageDoc.displayDirty = false;
 }
 
 void resizeSDLWindow(SDL_Window* window, int width, int height){
@@ -117,14 +191,13 @@ void resizeSDLWindow(SDL_Window* window, int width, int height){
     SDL_SetWindowSize(window, width + widthbuffer, height + heightbuffer);
 }
 
-void rotateImage(int& imageWidth, int& imageHeight){
-    int pixelDataLen = imageWidth*imageHeight*4;
-    unsigned char* pixelData = new unsigned char[pixelDataLen];
-    unsigned char* pixelDataCopy = new unsigned char[pixelDataLen];
+void rotateImage(ImageDocument& imageDoc){
+    int imageWidth = imageDoc.width;
+    int imageHeight = imageDoc.height;
     
-    glActiveTexture(IMAGE_DISPLAY);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelDataCopy);
+    unsigned char* pixelDataCopy = imageDoc.display.data();
+    imageDoc.scratch.resize(imageDoc.pixelDataLen());
+    unsigned char* pixelData = imageDoc.scratch.data();
     
     // rotate the pixel data and write it back
     // https://stackoverflow.com/questions/16684856/rotating-a-2d-pixel-array-by-90-degrees
@@ -142,221 +215,207 @@ void rotateImage(int& imageWidth, int& imageHeight){
         }
     }
     // swap image height and width
-    int temp = imageWidth;
-    imageWidth = imageHeight;
-    imageHeight = temp;
+    imageDoc.width = imageHeight;
+    imageDoc.height = imageWidth;
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    
-    glActiveTexture(TEMP_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    
-    delete[] pixelData;
-    delete[] pixelDataCopy;
+    imageDoc.display.swap(imageDoc.scratch);
+    imageDoc.temp = imageDoc.display;
+    imageDoc.displayDirty = true;
 }
 
-void updateTempImageState(int imageWidth, int imageHeight){
-    // take current image data in IMAGE_DISPLAY and update TEMP_IMAGE with that data
-    int pixelDataLen = imageWidth*imageHeight*4; // 4 because rgba
-    unsigned char* pixelData = new unsigned char[pixelDataLen];
-        
-    glActiveTexture(IMAGE_DISPLAY);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData); // uses currently bound texture from importImage()
-    
-    glActiveTexture(TEMP_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    
-    delete[] pixelData;
+void updateTempImageState(ImageDocument& imageDoc){
+    // take current image data in display and update temp with that data
+    imageDoc.temp = imageDoc.display;
 }
 
-void resetImageState(int& imageWidth, int& imageHeight, int originalWidth, int originalHeight){
-    imageWidth = originalWidth;
-    imageHeight = originalHeight;
-    int pixelDataLen = imageWidth*imageHeight*4; // 4 because rgba
-    unsigned char* pixelData = new unsigned char[pixelDataLen];
-        
-    glActiveTexture(ORIGINAL_IMAGE);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
+void resetImageState(ImageDocument& imageDoc){
+    imageDoc.width = imageDoc.originalWidth;
+    imageDoc.height = imageDoc.originalHeight;
     
     // update temp image and display image
-    glActiveTexture(IMAGE_DISPLAY);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    
-    glActiveTexture(TEMP_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-    
-    delete[] pixelData;
+    imageDoc.display = imageDoc.original;
+    imageDoc.temp = imageDoc.original;
+    imageDoc.displayDirty = true;
 }
 
-void setFilter(Filter filter, std::map<Filter, bool>& filtersWithParams, int imageWidth, int imageHeight){
+void setFilter(Filter filter, std::map<Filter, bool>& filtersWithParams, ImageDocument& imageDoc){
     setFilterState(filter, filtersWithParams);
-    updateTempImageState(imageWidth, imageHeight);
+    updateTempImageState(imageDoc);
+}
+
+// filters with parameters start from the temp image so that moving a slider re-runs the filter
+// instead of stacking it. the others apply to whatever is currently displayed
+static bool filterStartsFromTemp(Filter filter){
+    switch(filter){
+        case Filter::Saturation:
+        case Filter::Outline:
+        case Filter::Mosaic:
+        case Filter::ChannelOffset:
+        case Filter::Crt:
+        case Filter::Voronoi:
+        case Filter::Thinning:
+        case Filter::Kuwahara:
+        case Filter::EdgeDetection:
+        case Filter::Blur:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// filters that read from an unmodified copy of the image while writing the result
+static bool filterNeedsSourceCopy(Filter filter){
+    switch(filter){
+        case Filter::Outline:
+        case Filter::Mosaic:
+        case Filter::ChannelOffset:
+        case Filter::Crt:
+        case Filter::Kuwahara:
+        case Filter::EdgeDetection:
+            return true;
+        default:
+            return false;
+    }
 }
 
 void doFilter(
-    int imageWidth,
-    int imageHeight,
+    ImageDocument& imageDoc,
     Filter filter,
     FilterParameters& filterParams,
     bool isGif,
     ReconstructedGifFrames& gifFrames,
     SDL_Renderer* renderer
 ){
-    int pixelDataLen = imageWidth * imageHeight * 4; // 4 because rgba
-    unsigned char* pixelData = new unsigned char[pixelDataLen];
-            
+    int imageWidth = imageDoc.width;
+    int imageHeight = imageDoc.height;
+    int pixelDataLen = imageDoc.pixelDataLen();
+    unsigned char* sourceImageCopy = nullptr;
+    
+    if(filterStartsFromTemp(filter)){
+        // temp doesn't get modified, so it can be the source copy as is
+        std::copy(imageDoc.temp.begin(), imageDoc.temp.end(), imageDoc.display.begin());
+        sourceImageCopy = imageDoc.temp.data();
+    }else if(filterNeedsSourceCopy(filter)){
+        imageDoc.scratch.assign(imageDoc.display.begin(), imageDoc.display.end());
+        sourceImageCopy = imageDoc.scratch.data();
+    }
+    
+    unsigned char* pixelData = imageDoc.display.data();
+    
     // do the thing
-    switch(filter){
-        case Filter::Grayscale:
-            glActiveTexture(IMAGE_DISPLAY);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            grayscale(pixelData, pixelDataLen);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        case Filter::Invert:
-            glActiveTexture(IMAGE_DISPLAY);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            invert(pixelData, pixelDataLen);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        case Filter::Dots:
-            glActiveTexture(IMAGE_DISPLAY);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            dots(pixelData, pixelDataLen, imageWidth, imageHeight, renderer);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        case Filter::Saturation:
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            saturate(pixelData, pixelDataLen, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        case Filter::Outline: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            outline(pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;            
-            break;
-        }
-        case Filter::Mosaic: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            mosaic(pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;
-            break;
-        }
-        case Filter::ChannelOffset: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            channelOffset(pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;
-            break;
-        }
-        case Filter::Crt: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            crt(pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;            
-            break;
-        }
-        case Filter::Voronoi: {
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            voronoi(pixelData, pixelDataLen, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        }
-        case Filter::Thinning: {
-            glActiveTexture(TEMP_IMAGE);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            thinning(pixelData, pixelDataLen, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        }
-        case Filter::Kuwahara: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(IMAGE_DISPLAY); // TODO: change to TEMP_IMAGE if filter has configurable params
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            kuwahara(pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;
-            break;
-        }
-        case Filter::Blur: {
-            glActiveTexture(IMAGE_DISPLAY); // TODO: change to TEMP_IMAGE if filter has configurable params
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            blur(pixelData, imageWidth, imageHeight, filterParams);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            break;
-        }
-        case Filter::EdgeDetection: {
-            unsigned char* sourceImageCopy = new unsigned char[pixelDataLen];
-            glActiveTexture(IMAGE_DISPLAY);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, sourceImageCopy);
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            edgeDetection(pixelData, sourceImageCopy, imageWidth, imageHeight);
-            glActiveTexture(IMAGE_DISPLAY);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            delete[] sourceImageCopy;
-            break;
-        }
-        default:
-            break;
+    if(filter == Filter::Dots){
+        dots(pixelData, pixelDataLen, imageWidth, imageHeight, renderer);
+    }else{
+        applyFilter(filter, pixelData, sourceImageCopy, imageWidth, imageHeight, filterParams);
     }
     
+    imageDoc.displayDirty = true;
+    
     if(isGif){
-        // update reconstructedGifFrames - this modifies the stored image data for this frame!
+        // keep the edited frame - this replaces the stored image data for this frame!
         //std::cout << "updating frame " << gifFrames.currFrameIndex << "\n";
-        std::copy(pixelData, pixelData + pixelDataLen, gifFrames.frames[gifFrames.currFrameIndex]);
+        gifFrames.source.setFrame(gifFrames.currFrameIndex, pixelData);
     }
-    
-    delete[] pixelData;
 }
 
-std::vector<int> extractPixelColor(int xCoord, int yCoord, int imageWidth, int imageHeight){
-    int pixelDataLen = imageWidth*imageHeight*4;
-    unsigned char* imageData = new unsigned char[pixelDataLen];
+void startGifBatchFilter(GifBatchFilter& batch, Filter filter, const FilterParameters& params){
+    batch.running = true;
+    batch.filter = filter;
+    batch.params = params;
+    batch.nextFrame = 0;
+    batch.framesPerGroup = 1;
+}
+
+// filter frames until about GIF_BATCH_STEP_MS have gone by (at least one group of them). once the last ones are done
+// the current frame gets shown again and it returns false
+bool continueGifBatchFilter(GifBatchFilter& batch, ReconstructedGifFrames& gifFrames, ImageDocument& imageDoc){
+    if(!batch.running){
+        return false;
+    }
     
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    GifFrameSource& source = gifFrames.source;
+    int width = source.getWidth();
+    int height = source.getHeight();
+    int numFrames = source.getFrameCount();
+    size_t frameBytes = 4 * (size_t)width * height;
+    bool needsSourceCopy = filterNeedsSourceCopy(batch.filter);
+    Uint32 stepStart = SDL_GetTicks();
+    
+    do {
+        // one frame per thread at most. getFrame's pixels only last until the next call, so they get copied out first
+        int count = std::min(batch.framesPerGroup, numFrames - batch.nextFrame);
+        batch.frames.resize(count);
+        batch.sources.resize(needsSourceCopy ? count : 0);
+        for(int i = 0; i < count; i++){
+            const unsigned char* frame = source.getFrame(batch.nextFrame + i);
+            batch.frames[i].assign(frame, frame + frameBytes);
+            if(needsSourceCopy){
+                batch.sources[i] = batch.frames[i];
+            }
+        }
+        
+        Uint32 groupStart = SDL_GetTicks();
+        parallelFor(0, count, [&](int start, int end){
+            for(int i = start; i < end; i++){
+                // thinning writes to its parameters, so each frame gets its own copy
+                FilterParameters params = batch.params;
+                applyFilter(batch.filter, batch.frames[i].data(), needsSourceCopy ? batch.sources[i].data() : nullptr, width, height, params);
+            }
+        });
+        Uint32 groupTime = SDL_GetTicks() - groupStart;
+        
+        for(int i = 0; i < count; i++){
+            source.setFrame(batch.nextFrame + i, batch.frames[i].data());
+        }
+        
+        // the frame on screen got filtered, so show it that way
+        if(gifFrames.currFrameIndex >= batch.nextFrame && gifFrames.currFrameIndex < batch.nextFrame + count){
+            displayGifFrame(gifFrames, imageDoc);
+        }
+        batch.nextFrame += count;
+        
+        // a single frame is split across the threads by the filter itself, so start with that and only
+        // filter more frames side by side while a group of them still fits in a step easily
+        if(groupTime * 2 < GIF_BATCH_STEP_MS){
+            batch.framesPerGroup = std::min(2 * batch.framesPerGroup, getThreadCount());
+        }else if(groupTime > GIF_BATCH_STEP_MS){
+            batch.framesPerGroup = std::max(1, batch.framesPerGroup / 2);
+        }
+    } while(batch.nextFrame < numFrames && SDL_GetTicks() - stepStart < GIF_BATCH_STEP_MS);
+    
+    if(batch.nextFrame >= numFrames){
+        cancelGifBatchFilter(batch);
+        displayGifFrame(gifFrames, imageDoc);
+        return false;
+    }
+    return true;
+}
+
+void cancelGifBatchFilter(GifBatchFilter& batch){
+    // frames that are done keep the filter
+    batch.running = false;
+    batch.nextFrame = 0;
+    batch.framesPerGroup = 1;
+    std::vector<std::vector<unsigned char>>().swap(batch.frames);
+    std::vector<std::vector<unsigned char>>().swap(batch.sources);
+}
+
+std::vector<int> extractPixelColor(int xCoord, int yCoord, ImageDocument& imageDoc){
+    int imageWidth = imageDoc.width;
+    unsigned char* imageData = imageDoc.display.data();
     
     int r = (int)imageData[xCoord*4 + yCoord*imageWidth*4];
     int g = (int)imageData[xCoord*4 + yCoord*imageWidth*4 + 1];
     int b = (int)imageData[xCoord*4 + yCoord*imageWidth*4 + 2];
     
-    delete[] imageData;
-    
     std::vector<int> color{r, g, b, 255};
     return color;
 }
 
-void swapColors(ImVec4& colorToChange, ImVec4& colorToChangeTo, int imageWidth, int imageHeight){
-    int pixelDataLen = imageWidth*imageHeight*4;
-    unsigned char* imageData = new unsigned char[pixelDataLen];
-    
-    glActiveTexture(IMAGE_DISPLAY);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+void swapColors(ImVec4& colorToChange, ImVec4& colorToChangeTo, ImageDocument& imageDoc){
+    int imageWidth = imageDoc.width;
+    int imageHeight = imageDoc.height;
+    unsigned char* imageData = imageDoc.display.data();
     
     for(int row = 0; row < imageHeight; row++){
         for(int col = 0; col < imageWidth; col++){
@@ -372,86 +431,21 @@ void swapColors(ImVec4& colorToChange, ImVec4& colorToChangeTo, int imageWidth,
         }
     }
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-    
-    delete[] imageData;
-}
-
-void reconstructGifFrames(ReconstructedGifFrames& gifFrames, GifFileType* gifImage){
-    // clear out old frames
-    gifFrames.reset();
-    
-    assert(gifFrames.frames.empty());
-    
-    int numFrames = gifImage->ImageCount;
-    
-    for(int i = 0; i < numFrames; i++){
-        SavedImage frame = gifImage->SavedImages[i];
-        GifImageDesc imageDesc = frame.ImageDesc;
-        ColorMapObject* colorMap = imageDesc.ColorMap ? imageDesc.ColorMap : gifImage->SColorMap;
-    
-        int frameWidth = imageDesc.Width;
-        int frameHeight = imageDesc.Height;
-        int pixelDataLen = frameWidth * frameHeight * 4;
-    
-        unsigned char* frameData = new unsigned char[pixelDataLen];
-        
-        // copy over previous frame 
-        if(i > 0) std::copy(gifFrames.frames[i-1], gifFrames.frames[i-1]+pixelDataLen, frameData);
-        
-        // then update any pixels as needed
-        int imageDataIndex = 0;
-        for(int row = 0; row < frameHeight; row++){
-            for(int col = 0; col < frameWidth; col++){
-                int pixelDataIndex = frame.RasterBits[row * frameWidth + col];
-                if(pixelDataIndex != gifImage->SBackGroundColor){
-                    GifColorType rgb = colorMap->Colors[pixelDataIndex];
-                    frameData[imageDataIndex++] = rgb.Red;
-                    frameData[imageDataIndex++] = rgb.Green;
-                    frameData[imageDataIndex++] = rgb.Blue;
-                    frameData[imageDataIndex++] = 255;
-                }else{
-                    // skip this pixel
-                    imageDataIndex += 4;
-                }
-            }
-        }
-        
-        gifFrames.frames.push_back(frameData);
-    }
+    imageDoc.displayDirty = true;
 }
 
-void displayGifFrame(GifFileType* gifImage, ReconstructedGifFrames& gifFrames){
+void displayGifFrame(ReconstructedGifFrames& gifFrames, ImageDocument& imageDoc){
     // https://stackoverflow.com/questions/56651645/how-do-i-get-the-rgb-colour-data-from-a-giflib-savedimage-structure
     // https://gist.github.com/suzumura-ss/a5e922994513e44226d33c3a0c2c60d1
     // https://stackoverflow.com/questions/26958369/apply-patch-between-gif-frames
     // https://commandlinefanatic.com/cgi-bin/showarticle.cgi?article=art011
     // http://giflib.sourceforge.net/whatsinagif/bits_and_bytes.html
     
-    /* TODO
-        - make sure any edits to frames get saved somewhere? maybe this code should
-          run for each frame after loading in a new gif image and we can store them
-          somewhere. the 'next' and 'prev' frame buttons can then access the stored images
-          instead of running this code for each button press
-    */
-    
-    SavedImage currFrame = gifImage->SavedImages[gifFrames.currFrameIndex];
-    GifImageDesc imageDesc = currFrame.ImageDesc;
-    int frameWidth = imageDesc.Width;
-    int frameHeight = imageDesc.Height;
-    
-    // use reconstructedGifFrames struct to get the frame
+    // the frame gets decoded (from the nearest keyframe before it) if it isn't cached
     //std::cout << "displaying frame " << gifFrames.currFrameIndex << "\n";
-    unsigned char* imageData = gifFrames.frames[gifFrames.currFrameIndex];
-    
-    glActiveTexture(IMAGE_DISPLAY);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frameWidth, frameHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-    
-    glActiveTexture(ORIGINAL_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frameWidth, frameHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    const unsigned char* imageData = gifFrames.source.getFrame(gifFrames.currFrameIndex);
     
-    glActiveTexture(TEMP_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frameWidth, frameHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+    loadImageDocument(imageDoc, imageData, gifFrames.source.getWidth(), gifFrames.source.getHeight());
 }
 
 void setupAPNGFrames(APNGData& pngData, SDL_Renderer* renderer){
@@ -521,7 +515,7 @@ void setupAPNGFrames(APNGData& pngData, SDL_Renderer* renderer){
     SDL_RenderCopy(renderer, pngData.textures[pngData.currFrame], NULL, &destRect);
 }
 
-void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer){
+void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer, ImageDocument& imageDoc){
     stbi__apng_directory* dir = (stbi__apng_directory*) (pngData.data + pngData.dirOffset);
     stbi__apng_frame_directory_entry* frame = &(dir->frames[pngData.currFrame]);
     
@@ -580,13 +574,16 @@ void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer){
     rect.w = pngData.width;
     rect.h = pngData.height;
     
-    unsigned char* imageData = (unsigned char*) malloc(pitchCoeff * pngData.width * pngData.height * sizeof(unsigned char));
+    // read straight into the display image (the texture is always rgba)
+    imageDoc.width = pngData.width;
+    imageDoc.height = pngData.height;
+    imageDoc.display.resize(pitchCoeff * pngData.width * pngData.height);
     
     int getImageData = SDL_RenderReadPixels(
                          renderer,
                          &rect,
                          SDL_PIXELFORMAT_RGBA32,
-                         imageData,
+                         imageDoc.display.data(),
                          pitchCoeff * pngData.width
                        );
                        
@@ -595,13 +592,8 @@ void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer){
         return;
     }
     
-    glActiveTexture(IMAGE_DISPLAY);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pngData.width, pngData.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-    
-    glActiveTexture(TEMP_IMAGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pngData.width, pngData.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-
-    free(imageData);
+    imageDoc.temp = imageDoc.display;
+    imageDoc.displayDirty = true;
 }
 
 int getAPNGDelay(int delayNumerator, int delayDenominator){
@@ -621,29 +613,8 @@ void decrementGifFrameIndex(ReconstructedGifFrames& gifFrames){
     }
 }
 
-void incrementGifFrameIndex(ReconstructedGifFrames& gifFrames, int totalNumFrames){
-    gifFrames.currFrameIndex = (gifFrames.currFrameIndex + 1) % totalNumFrames;
-}
-
-int extractFrameDelay(SavedImage& frame){
-    for(int i = 0; i < frame.ExtensionBlockCount; i++){
-        if(frame.ExtensionBlocks[i].ByteCount == 4){
-            // https://github.com/grimfang4/SDL_gifwrap/blob/master/SDL_gifwrap.c#L216
-            // https://gist.github.com/keefo/78a083c148b9da2d2a40
-            return 10*(frame.ExtensionBlocks[i].Bytes[1] + frame.ExtensionBlocks[i].Bytes[2]*256);
-        }
-    }
-    return -1;
-}
-
-void setFrameDelay(SavedImage& frame, int newDelay){
-    for(int i = 0; i < frame.ExtensionBlockCount; i++){
-        if(frame.ExtensionBlocks[i].ByteCount == 4){
-            // https://github.com/grimfang4/SDL_gifwrap/blob/master/SDL_gifwrap.c#L216
-            frame.ExtensionBlocks[i].Bytes[1] = (newDelay / 10) % 256;
-            frame.ExtensionBlocks[i].Bytes[2] = (double)(newDelay / 10) / 256.0;
-        }
-    }
+void incrementGifFrameIndex(ReconstructedGifFrames& gifFrames){
+    gifFrames.currFrameIndex = (gifFrames.currFrameIndex + 1) % gifFrames.source.getFrameCount();
 }
 
 void getExportedFileName(std::string& specifiedExportName, std::string& currFile, const char* extension){
@@ -660,20 +631,15 @@ void getExportedFileName(std::string& specifiedExportName, std::string& currFile
 
 void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
     static FilterParameters filterParams;
-    static GifFileType* gifImage = NULL; // TODO: make a smart pointer wrapper around this? need to delete at some point
     static ReconstructedGifFrames gifFrames;
+    static GifBatchFilter gifBatch;
     static APNGData apngData;
-    static GLuint texture;
-    static GLuint originalImage;
+    static ImageDocument imageDoc; // the original, temp and display images live here in cpu memory
     static bool showImage = false;
     static bool isGif = false;
     static bool isAPNG = false; // is animated PNG
     static bool isAnimating = false; // for gifs and apngs
     static Uint32 lastRender;        // for animating
-    static int imageHeight = 0;
-    static int imageWidth = 0;
-    static int originalImageHeight = 0;
-    static int originalImageWidth = 0;
     static int imageChannels = 4; //rgba
     static int newGifFrameDelay = 120;
     static char importImageFilepath[FILEPATH_MAX_LENGTH] = "test_image.png";
@@ -691,8 +657,9 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
         {Filter::Crt, false},
         {Filter::Voronoi, false},
         {Filter::Thinning, false},
-        //{Filter::Kuwahara, false} // TODO
-        //{Filter::Blur, false} // TODO
+        {Filter::Kuwahara, false},
+        {Filter::EdgeDetection, false},
+        {Filter::Blur, false},
     };
     
     bool importImageClicked = ImGui::Button("import image");
@@ -719,10 +686,10 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
         
         if(trimString(filepath) != ""){
             // free up any previous resources
-            if(gifImage != NULL){
-                // delete previous gif
-                free(gifImage); // since GIFLIB is C, use free and not delete
-                gifImage = NULL;
+            if(isGif){
+                // close previous gif
+                cancelGifBatchFilter(gifBatch);
+                gifFrames.reset();
                 isGif = false;
             }else if(isAPNG && apngData.data != NULL){
                 // delete previous apng
@@ -732,25 +699,13 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                 apngData.reset();
             }
             
-            // TODO: allow batch editing of frames?
             if(filepath.substr(filepath.size()-3) == "gif"){
-                int error;
-                std::cout << "creating a new GifFileType\n";
-                gifImage = DGifOpenFileName(filepath.c_str(), &error);
-                
-                if(gifImage == NULL){
-                    // error occurred. check error*
-                    std::cout << "oh no, an error occurred.\n";
+                // only finds where the frames are; they get decoded as they're shown
+                if(!gifFrames.source.open(filepath.c_str())){
+                    std::cout << "oh no, an error occurred with getting gif data.\n";
                 }else{
-                    // get the gif data
-                    int getData = DGifSlurp(gifImage);
-                    if(getData == GIF_ERROR){
-                        // error occurred
-                        std::cout << "oh no, an error occurred with getting gif data.\n";
-                    }
-                    //std::cout << "num gif frames: " << gifImage->ImageCount << '\n';
+                    //std::cout << "num gif frames: " << gifFrames.source.getFrameCount() << '\n';
                     isGif = true;
-                    reconstructGifFrames(gifFrames, gifImage);
                     gifFrames.currFrameIndex = 0;
                 }
             }
@@ -789,18 +744,18 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             
             bool loaded = importImage(
                 filepath.c_str(), 
-                &texture, 
-                &originalImage, 
-                &imageWidth, 
-                &imageHeight, 
+                imageDoc, 
                 &imageChannels
             );
             
+            if(loaded && isGif){
+                // composite the first frame the same way the others will be
+                displayGifFrame(gifFrames, imageDoc);
+            }
+            
             if(loaded){
                 showImage = true;
-                resizeSDLWindow(window, imageWidth, imageHeight);
-                originalImageWidth = imageWidth;
-                originalImageHeight = imageHeight;
+                resizeSDLWindow(window, imageDoc.width, imageDoc.height);
             }else{
                 ImGui::Text("import image failed");
                 showImage = false;
@@ -811,36 +766,36 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
     }
     
     if(showImage){
+        // while a filter is being applied to every frame of a gif, anything that edits or changes the
+        // shown frame (or exports) waits for it, since the batch would overwrite those edits or filter them again
+        ImGui::BeginDisabled(gifBatch.running);
+        
         // ROTATE IMAGE (only if not gif currently)
         if(!isGif && ImGui::Button("rotate image")){
-            rotateImage(imageWidth, imageHeight);
+            rotateImage(imageDoc);
         }
         if(!isGif) ImGui::SameLine();
         
         // RESET IMAGE
         if(ImGui::Button("reset image")){
-            resetImageState(imageWidth, imageHeight, originalImageWidth, originalImageHeight);
+            resetImageState(imageDoc);
             
             if(isGif){
                 // if a gif frame, we need to reset the stored pixel data to its original state
-                int pixelDataLen = imageWidth * imageHeight * 4;
-                unsigned char* pixelData = new unsigned char[pixelDataLen];
-                glActiveTexture(ORIGINAL_IMAGE);
-                glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-                std::copy(pixelData, pixelData + pixelDataLen, gifFrames.frames[gifFrames.currFrameIndex]);
-                delete[] pixelData;
+                gifFrames.source.setFrame(gifFrames.currFrameIndex, imageDoc.original.data());
             }
             
             filterParams.generateRandNum3();
         }
+        ImGui::EndDisabled();
         
-        ImGui::Text("size = %d x %d", imageWidth, imageHeight);
+        ImGui::Text("size = %d x %d", imageDoc.width, imageDoc.height);
         
         // https://github.com/ocornut/imgui/issues/3404 - mouse interaction
         const ImVec2 origin = ImGui::GetCursorScreenPos(); // Lock scrolled origin
         
         // show the image
-        ImGui::Image((void *)(intptr_t)texture, ImVec2(imageWidth, imageHeight));
+        ImGui::Image((void *)(intptr_t)imageDoc.displayTexture, ImVec2(imageDoc.width, imageDoc.height));
         
         // handle clicking on the image
         ImGuiIO& io = ImGui::GetIO();
@@ -852,9 +807,9 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
 
         if(isHovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left)){
             //ImGui::Text("%d, %d", (int)mousePosInImage.x, (int)mousePosInImage.y);
-            if((int)mousePosInImage.y < imageHeight && (int)mousePosInImage.x < imageWidth){
+            if((int)mousePosInImage.y < imageDoc.height && (int)mousePosInImage.x < imageDoc.width){
                 // ensure coords are within image range
-                selectedPixelColor = extractPixelColor((int)mousePosInImage.x, (int)mousePosInImage.y, imageWidth, imageHeight);
+                selectedPixelColor = extractPixelColor((int)mousePosInImage.x, (int)mousePosInImage.y, imageDoc);
             }
         }
         
@@ -896,15 +851,16 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
         if(isGif){
             // https://github.com/ocornut/imgui/issues/37 ? how to work with SDL2 key input?
             if(!isAnimating){
+                ImGui::BeginDisabled(gifBatch.running);
                 if(ImGui::Button("prev frame")){
                     decrementGifFrameIndex(gifFrames);
-                    displayGifFrame(gifImage, gifFrames);
+                    displayGifFrame(gifFrames, imageDoc);
                 }
                 ImGui::SameLine();
                 
                 if(ImGui::Button("next frame")){
-                    incrementGifFrameIndex(gifFrames, gifImage->ImageCount);
-                    displayGifFrame(gifImage, gifFrames);
+                    incrementGifFrameIndex(gifFrames);
+                    displayGifFrame(gifFrames, imageDoc);
                 }
                 ImGui::SameLine();
                 
@@ -912,13 +868,12 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                     isAnimating = true;
                     lastRender = SDL_GetTicks();
                 }
+                ImGui::EndDisabled();
                 ImGui::SameLine();
                 
                 ImGui::Text((std::string("curr frame: ") + std::to_string(gifFrames.currFrameIndex)).c_str());
                 
-                SavedImage frame = gifImage->SavedImages[gifFrames.currFrameIndex];
-            
-                int delay = extractFrameDelay(frame);
+                int delay = gifFrames.source.getFrameDelay(gifFrames.currFrameIndex);
                 if(delay > -1){
                     ImGui::SameLine();
                     ImGui::Text((std::string("curr frame delay: ") + std::to_string(delay)).c_str());
@@ -928,20 +883,18 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                     ImGui::PopItemWidth();
                     ImGui::SameLine();
                     if(ImGui::Button("set new delay")){
-                        setFrameDelay(frame, newGifFrameDelay);
+                        gifFrames.source.setFrameDelay(gifFrames.currFrameIndex, newGifFrameDelay);
                     }
                     //ImGui::Text(std::to_string(delay));
                 }
                 
             }else{
                 // https://gist.github.com/jcredmond/9ef711b406e42a250daa3797ce96fd26
-                SavedImage frame = gifImage->SavedImages[gifFrames.currFrameIndex];
-                
-                int currFrameDelayMs = extractFrameDelay(frame);
+                int currFrameDelayMs = gifFrames.source.getFrameDelay(gifFrames.currFrameIndex);
                 if(currFrameDelayMs > -1 && SDL_GetTicks() - lastRender >= (Uint32)currFrameDelayMs){
                     lastRender = SDL_GetTicks();
-                    incrementGifFrameIndex(gifFrames, gifImage->ImageCount);
-                    displayGifFrame(gifImage, gifFrames);
+                    incrementGifFrameIndex(gifFrames);
+                    displayGifFrame(gifFrames, imageDoc);
                 }
                 
                 ImGui::Text((std::string("curr frame: ") + std::to_string(gifFrames.currFrameIndex)).c_str());
@@ -958,13 +911,13 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                 if(ImGui::Button("prev frame")){
                     if(apngData.currFrame > 0){
                         apngData.currFrame--;
-                        displayAPNGFrame(apngData, renderer);
+                        displayAPNGFrame(apngData, renderer, imageDoc);
                     }
                 }
                 ImGui::SameLine();
                 if(ImGui::Button("next frame")){
                     apngData.currFrame = (apngData.currFrame + 1) % dir->num_frames;
-                    displayAPNGFrame(apngData, renderer);
+                    displayAPNGFrame(apngData, renderer, imageDoc);
                 }
                 ImGui::SameLine();
                 ImGui::Text((std::string("curr frame: ") + std::to_string(apngData.currFrame)).c_str());
@@ -994,7 +947,7 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                 if(currFrameDelayMs > -1 && SDL_GetTicks() - lastRender >= (Uint32)currFrameDelayMs){
                     lastRender = SDL_GetTicks();
                     apngData.currFrame = (apngData.currFrame + 1) % dir->num_frames;
-                    displayAPNGFrame(apngData, renderer);
+                    displayAPNGFrame(apngData, renderer, imageDoc);
                 }
                 
                 ImGui::Text((std::string("curr frame: ") + std::to_string(apngData.currFrame)).c_str());
@@ -1005,6 +958,8 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             }
         }
         
+        ImGui::BeginDisabled(gifBatch.running);
+        
         // be able to swap colors
         // colorpicker help - https://github.com/ocornut/imgui/issues/3583
         static ImVec4 colorToChange;
@@ -1015,7 +970,7 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
         ImGui::ColorEdit4(":color to change to", (float*)&colorToChangeTo, ImGuiColorEditFlags_NoInputs);
         ImGui::SameLine();
         if(ImGui::Button("swap colors")){
-            swapColors(colorToChange, colorToChangeTo, imageWidth, imageHeight);
+            swapColors(colorToChange, colorToChangeTo, imageDoc);
         }
         
         // spacer
@@ -1044,16 +999,49 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             Filter selectedFilter = static_cast<Filter>(curr_filter_idx);
             if(filtersWithParams.find(selectedFilter) != filtersWithParams.end()){
                 // if user selected a filter with parameters
-                setFilter(selectedFilter, filtersWithParams, imageWidth, imageHeight);
+                setFilter(selectedFilter, filtersWithParams, imageDoc);
             }else{
                 clearFilterState(filtersWithParams);
 
                 // probably not the best way to do this but note that renderer is passed here just for the "dots" filter FYI
-                doFilter(imageWidth, imageHeight, selectedFilter, filterParams, isGif, gifFrames, renderer);
+                doFilter(imageDoc, selectedFilter, filterParams, isGif, gifFrames, renderer);
             }
         }
+        ImGui::EndDisabled();
         ImGui::SameLine();
         
+        if(isGif){
+            if(!gifBatch.running){
+                // the selected filter with the parameters as they are now. dots needs the renderer so it can't be done this way
+                Filter selectedFilter = static_cast<Filter>(curr_filter_idx);
+                ImGui::BeginDisabled(selectedFilter == Filter::Dots);
+                if(ImGui::Button("apply to all frames")){
+                    // if the filter's parameters are showing, the current frame already has it on top of temp
+                    auto showingParams = filtersWithParams.find(selectedFilter);
+                    if(showingParams != filtersWithParams.end() && showingParams->second){
+                        gifFrames.source.setFrame(gifFrames.currFrameIndex, imageDoc.temp.data());
+                    }
+                    clearFilterState(filtersWithParams);
+                    startGifBatchFilter(gifBatch, selectedFilter, filterParams);
+                }
+                ImGui::EndDisabled();
+            }else{
+                int numFrames = gifFrames.source.getFrameCount();
+                std::string progress = std::to_string(gifBatch.nextFrame) + "/" + std::to_string(numFrames) + " frames";
+                ImGui::ProgressBar((float)gifBatch.nextFrame / numFrames, ImVec2(200, 0), progress.c_str());
+                ImGui::SameLine();
+                if(ImGui::Button("cancel")){
+                    cancelGifBatchFilter(gifBatch);
+                    displayGifFrame(gifFrames, imageDoc);
+                }else{
+                    continueGifBatchFilter(gifBatch, gifFrames, imageDoc);
+                }
+            }
+            ImGui::SameLine();
+        }
+        
+        ImGui::BeginDisabled(gifBatch.running);
+        
         // show any parameters associated with current selected filter
         if(filtersWithParams[Filter::Saturation]){
             ImGui::Text("saturation filter parameters");
@@ -1066,28 +1054,28 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             
             // if any of the saturation parameters change, re-run the filter
             if(d1 || d2 || d3 || d4){
-                doFilter(imageWidth, imageHeight, Filter::Saturation, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Saturation, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::Outline]){
             ImGui::Text("outline filter parameters");
             if(ImGui::SliderInt("color difference limit", &filterParams.outlineLimit, 1, 20)){
-                doFilter(imageWidth, imageHeight, Filter::Outline, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Outline, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::Mosaic]){
             ImGui::Text("mosaic filter parameters");
             if(ImGui::SliderInt("mosaic chunk size", &filterParams.chunkSize, 1, 20)){
-                doFilter(imageWidth, imageHeight, Filter::Mosaic, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Mosaic, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::ChannelOffset]){
             ImGui::Text("channel offset parameters");
             if(ImGui::SliderInt("chan offset", &filterParams.chanOffset, 1, 15)){ // TODO: find out why using "channel offset" for the label produces an assertion error :0
-                doFilter(imageWidth, imageHeight, Filter::ChannelOffset, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::ChannelOffset, filterParams, isGif, gifFrames);
             }
         }
         
@@ -1099,28 +1087,69 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             bool d3 = ImGui::SliderFloat("intensity", &filterParams.intensity, 0.0f, 1.0f);
 
             if(d1 || d2 || d3){
-                doFilter(imageWidth, imageHeight, Filter::Crt, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Crt, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::Voronoi]){
             ImGui::Text("voronoi filter parameters");
-            if(ImGui::SliderInt("neighbor count", &filterParams.voronoiNeighborCount, 10, 60)){
-                doFilter(imageWidth, imageHeight, Filter::Voronoi, filterParams, isGif, gifFrames);
+            bool d1 = ImGui::SliderInt("neighbor count", &filterParams.voronoiNeighborCount, 10, 60);
+            bool d2 = ImGui::SliderInt("edge blend", &filterParams.voronoiEdgeBlend, 0, 20);
+            
+            if(d1 || d2){
+                doFilter(imageDoc, Filter::Voronoi, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::Thinning]){
             ImGui::Text("thinning filter parameters");
             if(ImGui::SliderInt("iterations", &filterParams.thinningIterations, 1, 100)){
-                doFilter(imageWidth, imageHeight, Filter::Thinning, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Thinning, filterParams, isGif, gifFrames);
+            }
+            if(ImGui::RadioButton("hilditch", &filterParams.thinningMethod, ThinningMethod::Hilditch)){
+                doFilter(imageDoc, Filter::Thinning, filterParams, isGif, gifFrames);
+            }
+            ImGui::SameLine();
+            if(ImGui::RadioButton("zhang-suen", &filterParams.thinningMethod, ThinningMethod::ZhangSuen)){
+                doFilter(imageDoc, Filter::Thinning, filterParams, isGif, gifFrames);
+            }
+            if(filterParams.thinningIterationsDone > 0 && filterParams.thinningIterationsDone < filterParams.thinningIterations){
+                ImGui::Text("converged after %d iterations", filterParams.thinningIterationsDone);
+            }
+        }
+        
+        if(filtersWithParams[Filter::Kuwahara]){
+            ImGui::Text("kuwahara filter parameters");
+            if(ImGui::SliderInt("quadrant size", &filterParams.kuwaharaFactor, 1, 32)){
+                doFilter(imageDoc, Filter::Kuwahara, filterParams, isGif, gifFrames);
+            }
+        }
+        
+        if(filtersWithParams[Filter::EdgeDetection]){
+            ImGui::Text("edge detection filter parameters");
+            bool d1 = ImGui::RadioButton("sobel 3x3", &filterParams.edgeKernel, EdgeKernel::Sobel3);
+            ImGui::SameLine();
+            bool d2 = ImGui::RadioButton("scharr", &filterParams.edgeKernel, EdgeKernel::Scharr3);
+            ImGui::SameLine();
+            bool d3 = ImGui::RadioButton("sobel 5x5", &filterParams.edgeKernel, EdgeKernel::Sobel5);
+            bool d4 = ImGui::RadioButton("red", &filterParams.edgeChannels, EdgeChannels::RedChannel);
+            ImGui::SameLine();
+            bool d5 = ImGui::RadioButton("luminance", &filterParams.edgeChannels, EdgeChannels::Luminance);
+            ImGui::SameLine();
+            bool d6 = ImGui::RadioButton("per channel", &filterParams.edgeChannels, EdgeChannels::PerChannel);
+            bool fast = filterParams.edgeMagnitude == EdgeMagnitude::L1Magnitude;
+            bool d7 = ImGui::Checkbox("fast magnitude (|gx| + |gy|)", &fast);
+            filterParams.edgeMagnitude = fast ? EdgeMagnitude::L1Magnitude : EdgeMagnitude::L2Magnitude;
+            
+            if(d1 || d2 || d3 || d4 || d5 || d6 || d7){
+                doFilter(imageDoc, Filter::EdgeDetection, filterParams, isGif, gifFrames);
             }
         }
         
         if(filtersWithParams[Filter::Blur]){
             ImGui::Text("blur filter parameters");
             if(ImGui::SliderInt("blur factor", &filterParams.blurFactor, 1, 8)){
-                doFilter(imageWidth, imageHeight, Filter::Blur, filterParams, isGif, gifFrames);
+                doFilter(imageDoc, Filter::Blur, filterParams, isGif, gifFrames);
             }
         }
         
@@ -1136,20 +1165,11 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
         std::string exportName(exportImageName);
         
         if(exportImageClicked){
-            glActiveTexture(IMAGE_DISPLAY);
-            
-            int pixelDataLen = imageWidth*imageHeight*4;
-            unsigned char* pixelData = new unsigned char[pixelDataLen];
-        
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-            
             std::string filepath(importImageFilepath);
             getExportedFileName(exportName, filepath, ".bmp");
             exportNameMsg.assign(exportName);
             
-            stbi_write_bmp(exportName.c_str(), imageWidth, imageHeight, 4, (void *)pixelData);
-            
-            delete[] pixelData;
+            stbi_write_bmp(exportName.c_str(), imageDoc.width, imageDoc.height, 4, (void *)imageDoc.display.data());
             
             ImGui::OpenPopup("message"); // show popup
         }
@@ -1162,13 +1182,12 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                 // need to use reconstructedGifFrames struct to write frames' image data to gif
                 GifWriter gifWriter;
                 
-                // need width, height of first frame (assuming uniform dimensions for frames)
-                int width = gifImage->SavedImages[0].ImageDesc.Width;
-                int height = gifImage->SavedImages[0].ImageDesc.Height;
-                
-                SavedImage frame = gifImage->SavedImages[1];
+                // every frame is the size of the gif's logical screen
+                int width = gifFrames.source.getWidth();
+                int height = gifFrames.source.getHeight();
+                int numFrames = gifFrames.source.getFrameCount();
                 
-                int delay = extractFrameDelay(frame);
+                int delay = gifFrames.source.getFrameDelay(std::min(1, numFrames - 1));
                 
                 std::string filepath(importImageFilepath);
                 getExportedFileName(exportName, filepath, ".gif");
@@ -1176,7 +1195,8 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                 
                 GifBegin(&gifWriter, exportName.c_str(), (uint32_t)width, (uint32_t)height, (uint32_t)delay/10);
                 
-                for(unsigned char* frame : gifFrames.frames){
+                // every frame in order, decoded in parallel where the gif allows it
+                gifFrames.source.forEachFrame([&](int frameIndex, const unsigned char* frame){
                     GifRGBA* pixelArr = new GifRGBA[sizeof(GifRGBA)*width*height];
                     
                     int pixelArrIdx = 0;
@@ -1191,7 +1211,7 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
                     GifWriteFrame(&gifWriter, pixelArr, (uint32_t)width, (uint32_t)height, (uint32_t)delay/10);
                     
                     delete[] pixelArr;
-                }
+                });
                 
                 GifEnd(&gifWriter);
                 
@@ -1199,6 +1219,8 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             }
         }
         
+        ImGui::EndDisabled();
+        
         // signal that the image export happened in popup
         if(ImGui::BeginPopupModal("message", NULL, ImGuiWindowFlags_AlwaysAutoResize)){
             ImGui::Text((std::string("exported image: ") + exportNameMsg).c_str()); // TODO: can the modal resize based on how much text there is?
@@ -1207,6 +1229,9 @@ void showImageEditor(SDL_Window* window, SDL_Renderer* renderer){
             }
             ImGui::EndPopup();
         }
+        
+        // send any edits made this frame to the gpu (at most one upload per frame)
+        uploadDisplayTexture(imageDoc);
     }
     
     //ImGui::EndChild();
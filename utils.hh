@@ -6,7 +6,7 @@
 
 #include <SDL.h>
 #include <GL/glew.h>
-#include "external/giflib/gif_lib.h"
+#include "gif_helper.hh"
 
 #include <string>
 #include <vector>
@@ -16,23 +16,50 @@
 #include <commctrl.h>
 #endif
 
-// struct for holding reconstructed gif frames (making sure all the frames are properly colored
-// since each frame given back by giflib only shows pixels that changed between frames)
+// the frames of the gif being edited, decoded as they're needed (see gif_helper.hh)
 struct ReconstructedGifFrames {
-    std::vector<unsigned char*> frames;
+    GifFrameSource source;
     int currFrameIndex = 0;
     
     void reset(){
-        for(unsigned char* frame : frames){
-            delete[] frame;
-        }
-        frames.erase(frames.begin(), frames.end());
+        source.close();
         currFrameIndex = 0;
     }
+};
+
+// a filter being applied to every frame of a gif. the frames get filtered in small groups for a few ms in
+// between ui frames so there can be a progress bar and a cancel button. a group starts out as one frame
+// split across the threads by the filter itself, and grows up to one frame per thread while they're quick
+struct GifBatchFilter {
+    bool running = false;
+    Filter filter = Filter::Grayscale;
+    FilterParameters params; // as they were when it started
+    int nextFrame = 0;       // frames before this one are done
+    int framesPerGroup = 1;  // how many frames get filtered side by side, adjusted to how long they take
+    std::vector<std::vector<unsigned char>> frames;  // the frames being filtered right now
+    std::vector<std::vector<unsigned char>> sources; // unmodified copies of them, for filters that need one
+};
+
+// the image being edited. the pixels live in cpu memory so filters never have to read them back from opengl;
+// the display texture just gets a copy of display whenever it changes
+struct ImageDocument {
+    std::vector<unsigned char> original; // as imported (or the current gif frame as decoded), for resetting
+    std::vector<unsigned char> temp;     // starting point for filters with parameters so moving a slider doesn't stack the filter
+    std::vector<unsigned char> display;  // what's on screen and what gets exported
+    std::vector<unsigned char> scratch;  // reused for filters that need an unmodified copy of display
+    int width = 0;
+    int height = 0;
+    int originalWidth = 0;
+    int originalHeight = 0;
+    GLuint displayTexture = 0;
+    int textureWidth = 0;  // size the texture storage was allocated with
+    int textureHeight = 0;
+    GLuint unpackBuffers[2] = {0, 0}; // pixel buffer objects, alternated between uploads
+    int nextUnpackBuffer = 0;
+    bool displayDirty = false; // display has changed since the last upload
     
-    ~ReconstructedGifFrames(){
-        //std::cout << "ReconstructedGifFrames destructor called.\n";
-        reset();
+    int pixelDataLen() const {
+        return width * height * 4;
     }
 };
 
@@ -69,32 +96,34 @@ struct APNGData {
 std::string trimString(std::string& str);
 std::string colorText(int r, int g, int b);
 
-bool importImage(const char* filename, GLuint* tex, GLuint* originalImage, int* width, int* height, int* channels);
+bool importImage(const char* filename, ImageDocument& imageDoc, int* channels);
+void loadImageDocument(ImageDocument& imageDoc, const unsigned char* imageData, int width, int height);
+void uploadDisplayTexture(ImageDocument& imageDoc);
+void releaseDisplayTexture(ImageDocument& imageDoc);
 
-void swapColors(ImVec4& colorToChange, ImVec4& colorToChangeTo, int imageWidth, int imageHeight);
-void updateTempImageState(int imageWidth, int imageHeight);
-void resetImageState(int& imageWidth, int& imageHeight, int originalWidth, int originalHeight);
+void swapColors(ImVec4& colorToChange, ImVec4& colorToChangeTo, ImageDocument& imageDoc);
+void updateTempImageState(ImageDocument& imageDoc);
+void resetImageState(ImageDocument& imageDoc);
 void resizeSDLWindow(SDL_Window* window, int width, int height);
 void showImageEditor(SDL_Window* window, SDL_Renderer* renderer);
-void rotateImage(int& imageWidth, int& imageHeight);
-std::vector<int> extractPixelColor(int xCoord, int yCoord, int imageWidth, int imageHeight);
-void displayGifFrame(GifFileType* gifImage, ReconstructedGifFrames& gifFrames);
+void rotateImage(ImageDocument& imageDoc);
+std::vector<int> extractPixelColor(int xCoord, int yCoord, ImageDocument& imageDoc);
+void displayGifFrame(ReconstructedGifFrames& gifFrames, ImageDocument& imageDoc);
 
 void setupAPNGFrames(APNGData& pngData, SDL_Renderer* renderer);
-void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer);
+void displayAPNGFrame(APNGData& pngData, SDL_Renderer* renderer, ImageDocument& imageDoc);
 int getAPNGDelay(int delayNumerator, int delayDenominator);
 
-void reconstructGifFrames(ReconstructedGifFrames& gifFrames, GifFileType* gifImage); // TODO: maybe make a method of the ReconstructedGifFrames struct?
-
 void decrementGifFrameIndex(ReconstructedGifFrames& gifFrames);
-void incrementGifFrameIndex(ReconstructedGifFrames& gifFrames, int totalNumFrames);
-int extractFrameDelay(SavedImage& frame);
-void setFrameDelay(SavedImage& frame, int newDelay);
+void incrementGifFrameIndex(ReconstructedGifFrames& gifFrames);
+
+void startGifBatchFilter(GifBatchFilter& batch, Filter filter, const FilterParameters& params);
+bool continueGifBatchFilter(GifBatchFilter& batch, ReconstructedGifFrames& gifFrames, ImageDocument& imageDoc);
+void cancelGifBatchFilter(GifBatchFilter& batch);
 
-void setFilter(Filter filter, std::map<Filter, bool>& filtersWithParams,  int imageWidth, int imageHeight);
+void setFilter(Filter filter, std::map<Filter, bool>& filtersWithParams, ImageDocument& imageDoc);
 void doFilter(
-    int imageWidth,
-    int imageHeight,
+    ImageDocument& imageDoc,
     Filter filter,
     FilterParameters& filterParams,
     bool isGif,
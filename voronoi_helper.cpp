@@ -1,5 +1,7 @@
 #include "voronoi_helper.hh"
 
+#include <climits>
+
 std::pair<int, int> getPixelCoords(int index, int width, int height){
     // assuming index represents the r channel of a pixel
     // index therefore represents the index of a pixel, since the pixel data
@@ -29,165 +31,444 @@ float getDist(int x1, int x2, int y1, int y2){
     return (float)((x1 - x2) * (x1 - x2)) + ((y1 - y2) * (y1 - y2)); // TODO: check out pow() vs reg multiplication
 }
 
-// check if a Node is a leaf (both children are null)
-bool isLeaf(Node* n){
-    return n->left == nullptr && n->right == nullptr;
+// deep enough for any tree that fits in an int, since each level adds at most one entry
+#define KD_TREE_MAX_STACK 64
+
+// how many queries in a row findNearestNeighbors checks against one shared list of candidates
+#define KD_TREE_MIN_QUERY_RUN 4
+#define KD_TREE_MAX_QUERY_RUN 32
+
+void build2dTree(KdTree& tree, const std::vector<CustomPoint>& pointsList){
+    int numPoints = (int)pointsList.size();
+    
+    // sort indices rather than the points themselves, then lay the points out once at the end
+    tree.pointOrder.resize(numPoints);
+    tree.splitDim.assign(numPoints, 0);
+    for(int i = 0; i < numPoints; i++){
+        tree.pointOrder[i] = i;
+    }
+    
+    std::pair<int, int> stack[KD_TREE_MAX_STACK];
+    int stackSize = 0;
+    if(numPoints > 0){
+        stack[stackSize++] = {0, numPoints};
+    }
+    
+    while(stackSize > 0){
+        int lo = stack[stackSize - 1].first;
+        int hi = stack[stackSize - 1].second;
+        stackSize--;
+        
+        int mid = lo + (hi - lo) / 2;
+        if(hi - lo > 1){
+            // split on the dimension the points are more spread out in
+            int minX = pointsList[tree.pointOrder[lo]].x;
+            int maxX = minX;
+            int minY = pointsList[tree.pointOrder[lo]].y;
+            int maxY = minY;
+            for(int i = lo + 1; i < hi; i++){
+                const CustomPoint& p = pointsList[tree.pointOrder[i]];
+                minX = std::min(minX, p.x);
+                maxX = std::max(maxX, p.x);
+                minY = std::min(minY, p.y);
+                maxY = std::max(maxY, p.y);
+            }
+            int dim = ((long long)maxY - minY > (long long)maxX - minX) ? 1 : 0;
+            tree.splitDim[mid] = (unsigned char)dim;
+            
+            // move the median to mid, with everything not greater before it and not less after it
+            std::nth_element(tree.pointOrder.begin() + lo, tree.pointOrder.begin() + mid, tree.pointOrder.begin() + hi, [&pointsList, dim](int a, int b){
+                return dim == 0 ? pointsList[a].x < pointsList[b].x : pointsList[a].y < pointsList[b].y;
+            });
+            
+            if(mid - lo > 0){
+                stack[stackSize++] = {lo, mid};
+            }
+            if(hi - (mid + 1) > 0){
+                stack[stackSize++] = {mid + 1, hi};
+            }
+        }
+    }
+    
+    tree.points.resize(numPoints);
+    for(int i = 0; i < numPoints; i++){
+        tree.points[i] = pointsList[tree.pointOrder[i]];
+    }
 }
 
-// recursive helper function to delete nodes of tree used in deleteTree
-void deleteHelper(Node* root){
-    if(root == nullptr){
+// add a point to a query's list of the best k so far (kept closest first), unless it's not close enough or already there
+static void addNeighbor(const KdTree& tree, int index, long long dist, int k, int* best, long long* bestDist, int& numBest){
+    int order = tree.pointOrder[index];
+    if(numBest == k && (dist > bestDist[k - 1] || (dist == bestDist[k - 1] && order >= tree.pointOrder[best[k - 1]]))){
         return;
     }
+    for(int i = 0; i < numBest; i++){
+        if(best[i] == index){
+            return;
+        }
+    }
     
-    deleteHelper(root->left);
-    deleteHelper(root->right);
-    root->left = nullptr;
-    root->right = nullptr;
-    delete root;
+    int pos = numBest < k ? numBest++ : k - 1;
+    while(pos > 0 && (dist < bestDist[pos - 1] || (dist == bestDist[pos - 1] && order < tree.pointOrder[best[pos - 1]]))){
+        best[pos] = best[pos - 1];
+        bestDist[pos] = bestDist[pos - 1];
+        pos--;
+    }
+    best[pos] = index;
+    bestDist[pos] = dist;
 }
 
-// delete all the nodes of a tree given the root 
-void deleteTree(Node*& root){
-    deleteHelper(root);
-    root = nullptr;
+// walk the tree for the k points closest to (x, y), adding to whatever is in best already
+static void searchTree(const KdTree& tree, int x, int y, int k, int* best, long long* bestDist, int& numBest){
+    int numPoints = (int)tree.points.size();
+    
+    // subtrees still to visit, each with the squared distance from (x, y) to the far side
+    // of the splitting line that led to it (nothing in it can be closer than that)
+    struct StackEntry {
+        int lo;
+        int hi;
+        long long minDist;
+    };
+    StackEntry stack[KD_TREE_MAX_STACK];
+    int stackSize = 0;
+    if(numPoints > 0){
+        stack[stackSize++] = {0, numPoints, 0};
+    }
+    
+    while(stackSize > 0){
+        StackEntry entry = stack[--stackSize];
+        
+        // not pruned when equal so an earlier point at the same distance can still get in
+        if(numBest == k && entry.minDist > bestDist[k - 1]){
+            continue;
+        }
+        
+        int mid = entry.lo + (entry.hi - entry.lo) / 2;
+        const CustomPoint& p = tree.points[mid];
+        long long dx = (long long)p.x - x;
+        long long dy = (long long)p.y - y;
+        addNeighbor(tree, mid, dx*dx + dy*dy, k, best, bestDist, numBest);
+        
+        if(entry.hi - entry.lo == 1){
+            continue;
+        }
+        
+        // go down the side (x, y) is on first, and come back for the other side if it could still hold something closer
+        long long diff = tree.splitDim[mid] == 0 ? (long long)x - p.x : (long long)y - p.y;
+        int nearLo = diff < 0 ? entry.lo : mid + 1;
+        int nearHi = diff < 0 ? mid : entry.hi;
+        int farLo = diff < 0 ? mid + 1 : entry.lo;
+        int farHi = diff < 0 ? entry.hi : mid;
+        
+        if(farHi > farLo){
+            stack[stackSize++] = {farLo, farHi, diff*diff};
+        }
+        if(nearHi > nearLo){
+            stack[stackSize++] = {nearLo, nearHi, entry.minDist};
+        }
+    }
 }
 
+int findNearestNeighbor(const KdTree& tree, int x, int y){
+    int nearest = -1;
+    long long nearestDist = 0;
+    int numBest = 0;
+    searchTree(tree, x, y, 1, &nearest, &nearestDist, numBest);
+    
+    return nearest;
+}
 
-// returns the root of the resulting 2d tree 
-// in this use case our dimensions will be x and y (since each pixel has an x,y coordinate), so only 2 dimensions 
-Node* build2dTree(std::vector<CustomPoint> pointsList, int currDim){
-    int maxDim = 2; // ensures dimension is either 0 or 1
-    
-    // base cases
-    if(pointsList.size() == 0){
-        return nullptr;
-    }
-    
-    if(pointsList.size() == 1){
-        Node* newNode = new Node();
-        newNode->data = {pointsList[0].x, pointsList[0].y};
-        newNode->dim = currDim;
-        newNode->point = pointsList[0];
-        return newNode;
-    }
-    
-    if(pointsList.size() == 2){
-        // since it's a BST, the 2nd element (at index 1) will be larger and thus the parent of 
-        // the 1st element, which will go to the left of the parent
-        Node* newParent = new Node();
-        newParent->data = {pointsList[1].x, pointsList[1].y};
-        newParent->dim = currDim;
-        newParent->point = pointsList[1];
-        
-        Node* newChild = new Node();
-        newChild->data = {pointsList[0].x, pointsList[0].y};
-        newChild->dim = (currDim + 1) % maxDim;
-        newChild->point = pointsList[0];
+// every point within radius of the box [left, right] x [top, bottom], sorted by where it was in the list the tree was built from
+static void findPointsNearBox(const KdTree& tree, long long left, long long top, long long right, long long bottom, long long radius, std::vector<int>& found){
+    found.clear();
+    
+    int numPoints = (int)tree.points.size();
+    std::pair<int, int> stack[KD_TREE_MAX_STACK];
+    int stackSize = 0;
+    if(numPoints > 0){
+        stack[stackSize++] = {0, numPoints};
+    }
+    
+    while(stackSize > 0){
+        int lo = stack[stackSize - 1].first;
+        int hi = stack[stackSize - 1].second;
+        stackSize--;
         
-        newParent->left = newChild;
+        int mid = lo + (hi - lo) / 2;
+        const CustomPoint& p = tree.points[mid];
+        long long dx = std::max(0LL, std::max(left - p.x, p.x - right));
+        long long dy = std::max(0LL, std::max(top - p.y, p.y - bottom));
+        if(dx*dx + dy*dy <= radius*radius){
+            found.push_back(mid);
+        }
         
-        return newParent;
+        // the left side only has points not greater than the split and the right side only points not less than it
+        long long split = tree.splitDim[mid] == 0 ? p.x : p.y;
+        long long boxMin = tree.splitDim[mid] == 0 ? left : top;
+        long long boxMax = tree.splitDim[mid] == 0 ? right : bottom;
+        if(mid > lo && split >= boxMin - radius){
+            stack[stackSize++] = {lo, mid};
+        }
+        if(hi > mid + 1 && split <= boxMax + radius){
+            stack[stackSize++] = {mid + 1, hi};
+        }
     }
     
-    // sort the current list in ascending order depending on the current dimension
-    char dim = (currDim == 0) ? 'x' : 'y';
-    std::sort(pointsList.begin(), pointsList.end(), [dim](const CustomPoint a, const CustomPoint b){
-        if(dim == 'x'){
-            return a.x < b.x;
-        }else{
-            return a.y < b.y;
-        }
+    std::sort(found.begin(), found.end(), [&tree](int a, int b){
+        return tree.pointOrder[a] < tree.pointOrder[b];
     });
+}
+
+void findNearestNeighbors(const KdTree& tree, const int* queryX, const int* queryY, int numQueries, int k, int* neighbors, long long* neighborDists){
+    if(k < 1 || k > KD_TREE_MAX_K){
+        return;
+    }
+    
+    std::vector<int> candidates;
+    std::vector<long long> candidateX;
+    std::vector<long long> candidateY;
     
-    // take the median point and set as new node
-    int midIndex = (int)floor((pointsList.size() - 1) / 2);
-    Node* newNode = new Node();
-    newNode->data = {pointsList[midIndex].x, pointsList[midIndex].y};
-    newNode->dim = currDim;
-    newNode->point = pointsList[midIndex];
+    int best[KD_TREE_MAX_K];
+    long long bestDist[KD_TREE_MAX_K];
+    int numBest = 0;
     
-    // split the points list into two parts and pass each part to each subtree
-    std::vector<CustomPoint> leftHalf; //= std::vector<CustomPoint>(pointsList.begin(), pointsList.begin() + midIndex);
-    for(int i = 0; i < midIndex; i++){
-        leftHalf.push_back(pointsList[i]);
+    // how many queries share a list. the list gets long when a run covers much more than the
+    // distance to the neighbors, so runs shrink where the points are dense and grow back where they're not
+    int runLength = KD_TREE_MAX_QUERY_RUN;
+    
+    int runEnd = 0;
+    for(int runStart = 0; runStart < numQueries; runStart = runEnd){
+        runEnd = std::min(numQueries, runStart + runLength);
+        
+        long long left = queryX[runStart];
+        long long right = left;
+        long long top = queryY[runStart];
+        long long bottom = top;
+        for(int q = runStart + 1; q < runEnd; q++){
+            left = std::min(left, (long long)queryX[q]);
+            right = std::max(right, (long long)queryX[q]);
+            top = std::min(top, (long long)queryY[q]);
+            bottom = std::max(bottom, (long long)queryY[q]);
+        }
+        
+        // neighbors of the middle of the run, starting from the previous run's as the best guess
+        long long midX = left + (right - left) / 2;
+        long long midY = top + (bottom - top) / 2;
+        int prevBest[KD_TREE_MAX_K];
+        int numPrev = numBest;
+        std::copy(best, best + numBest, prevBest);
+        numBest = 0;
+        for(int i = 0; i < numPrev; i++){
+            const CustomPoint& p = tree.points[prevBest[i]];
+            long long dx = p.x - midX;
+            long long dy = p.y - midY;
+            addNeighbor(tree, prevBest[i], dx*dx + dy*dy, k, best, bestDist, numBest);
+        }
+        searchTree(tree, (int)midX, (int)midY, k, best, bestDist, numBest);
+        
+        // each query in the run is at most halfDiagonal from the middle, so its k neighbors are
+        // no farther than the middle's k-th neighbor plus halfDiagonal. only those few points need checking
+        long long radius = LLONG_MAX / 4;
+        if(numBest == k){
+            double halfDiagonal = std::sqrt((double)std::max(midX - left, right - midX) * std::max(midX - left, right - midX) +
+                                            (double)std::max(midY - top, bottom - midY) * std::max(midY - top, bottom - midY));
+            double neighborDist = std::sqrt((double)bestDist[k - 1]);
+            radius = (long long)std::ceil(neighborDist + halfDiagonal) + 1; // rounded up to stay on the safe side
+            
+            if(halfDiagonal > 2 * neighborDist + 1){
+                runLength = std::max(KD_TREE_MIN_QUERY_RUN, runLength / 2);
+            }else if(halfDiagonal < neighborDist / 2){
+                runLength = std::min(KD_TREE_MAX_QUERY_RUN, runLength * 2);
+            }
+        }
+        if(radius > 3037000499LL / 2){
+            // fewer than k points, or so far apart that radius*radius would overflow: check all of them
+            findPointsNearBox(tree, LLONG_MIN / 4, LLONG_MIN / 4, LLONG_MAX / 4, LLONG_MAX / 4, 0, candidates);
+        }else{
+            findPointsNearBox(tree, left, top, right, bottom, radius, candidates);
+        }
+        
+        int numCandidates = (int)candidates.size();
+        candidateX.resize(numCandidates);
+        candidateY.resize(numCandidates);
+        for(int c = 0; c < numCandidates; c++){
+            candidateX[c] = tree.points[candidates[c]].x;
+            candidateY[c] = tree.points[candidates[c]].y;
+        }
+        
+        for(int q = runStart; q < runEnd; q++){
+            int* queryNeighbors = neighbors + (long long)q*k;
+            long long queryDists[KD_TREE_MAX_K];
+            int numFound = 0;
+            
+            // candidates are in the order the points were added, so keeping the first of equally close ones breaks ties
+            for(int c = 0; c < numCandidates; c++){
+                long long dx = candidateX[c] - queryX[q];
+                long long dy = candidateY[c] - queryY[q];
+                long long dist = dx*dx + dy*dy;
+                if(numFound == k && dist >= queryDists[k - 1]){
+                    continue;
+                }
+                
+                int pos = numFound < k ? numFound++ : k - 1;
+                while(pos > 0 && dist < queryDists[pos - 1]){
+                    queryNeighbors[pos] = queryNeighbors[pos - 1];
+                    queryDists[pos] = queryDists[pos - 1];
+                    pos--;
+                }
+                queryNeighbors[pos] = candidates[c];
+                queryDists[pos] = dist;
+            }
+            
+            for(int i = 0; i < k; i++){
+                if(i >= numFound){
+                    queryNeighbors[i] = -1;
+                }
+                if(neighborDists){
+                    neighborDists[(long long)q*k + i] = i < numFound ? queryDists[i] : -1;
+                }
+            }
+        }
     }
+}
+
+void buildSeedGrid(SeedGrid& grid, const std::vector<CustomPoint>& seeds, int width, int height){
+    int numSeeds = (int)seeds.size();
     
-    std::vector<CustomPoint> rightHalf; //= std::vector<CustomPoint>(pointsList.begin() + midIndex + 1, pointsList.end());
-    for(int j = midIndex + 1; j < (int)pointsList.size(); j++){
-        rightHalf.push_back(pointsList[j]);
+    // bounding box of the image and the seeds (seeds can be nudged off the image)
+    int minX = 0;
+    int minY = 0;
+    int maxX = width - 1;
+    int maxY = height - 1;
+    for(const CustomPoint& p : seeds){
+        minX = std::min(minX, p.x);
+        minY = std::min(minY, p.y);
+        maxX = std::max(maxX, p.x);
+        maxY = std::max(maxY, p.y);
     }
     
-    newNode->left = build2dTree(leftHalf, (currDim + 1) % maxDim);
-    newNode->right = build2dTree(rightHalf, (currDim + 1) % maxDim);
+    // aim for about 2 seeds per cell
+    double area = (double)(maxX - minX + 1) * (maxY - minY + 1);
+    int cellSize = (int)std::sqrt(2.0 * area / std::max(1, numSeeds));
+    cellSize = std::max(1, cellSize);
     
-    return newNode;
+    grid.minX = minX;
+    grid.minY = minY;
+    grid.cellSize = cellSize;
+    grid.cols = (maxX - minX) / cellSize + 1;
+    grid.rows = (maxY - minY) / cellSize + 1;
+    
+    // counting sort of the seeds by cell
+    int numCells = grid.cols * grid.rows;
+    std::vector<int> seedCell(numSeeds);
+    grid.cellStart.assign(numCells + 1, 0);
+    for(int i = 0; i < numSeeds; i++){
+        int col = (seeds[i].x - minX) / cellSize;
+        int row = (seeds[i].y - minY) / cellSize;
+        seedCell[i] = row * grid.cols + col;
+        grid.cellStart[seedCell[i] + 1]++;
+    }
+    for(int c = 0; c < numCells; c++){
+        grid.cellStart[c + 1] += grid.cellStart[c];
+    }
+    
+    grid.seeds.resize(numSeeds);
+    grid.seedOrder.resize(numSeeds);
+    std::vector<int> next(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    for(int i = 0; i < numSeeds; i++){
+        int idx = next[seedCell[i]]++;
+        grid.seeds[idx] = seeds[i];
+        grid.seedOrder[idx] = i;
+    }
 }
 
-// recursive helper function for finding nearest neighbor of a given point's x and y coords 
-void findNearestNeighborHelper(Node* root, CustomPoint& nearestNeighbor, float& minDist, int x, int y){
-    float currDist = getDist(root->data.first, x, root->data.second, y);
+int findNearestSeed(const SeedGrid& grid, int x, int y){
+    int cellSize = grid.cellSize;
+    int cellCol = (x - grid.minX) / cellSize;
+    int cellRow = (y - grid.minY) / cellSize;
     
-    if(isLeaf(root)){
-        if(currDist < minDist){
-            nearestNeighbor = root->point;
-            minDist = currDist;
-        }
-    }else{
-        if(currDist < minDist){
-            nearestNeighbor = root->point;
-            minDist = currDist;
+    // position of (x, y) inside its cell
+    int offsetX = (x - grid.minX) - cellCol * cellSize;
+    int offsetY = (y - grid.minY) - cellRow * cellSize;
+    
+    int best = -1;
+    long long bestDist = 0;
+    int maxRing = std::max(std::max(cellCol, grid.cols - 1 - cellCol), std::max(cellRow, grid.rows - 1 - cellRow));
+    
+    for(int ring = 0; ring <= maxRing; ring++){
+        if(best != -1 && ring > 0){
+            // anything in this ring is outside the square of cells already searched,
+            // so it's at least as far as the nearest side of that square
+            long long gap = std::min(
+                std::min((long long)offsetX, (long long)cellSize - 1 - offsetX),
+                std::min((long long)offsetY, (long long)cellSize - 1 - offsetY)
+            ) + (long long)(ring - 1) * cellSize + 1;
+            if(gap * gap > bestDist){
+                break;
+            }
         }
         
-        if(root->left && !root->right){
-            // if a node has one child, it will always be the left child
-            findNearestNeighborHelper(root->left, nearestNeighbor, minDist, x, y);
-        }else{
-            // find the right direction to go in the tree based on dimension //distance
-            int currDimToCompare = (root->dim == 0) ? x : y;
-            
-            if(currDimToCompare == x){
-                // is x greater than the current node's x? if so, we want to go right. else left.
-                if(x > root->data.first){
-                    findNearestNeighborHelper(root->right, nearestNeighbor, minDist, x, y);
-                    
-                    // then, we check if the other subtree might actually have an even closer neighbor!
-                    if(x - minDist < root->data.first){
-                        findNearestNeighborHelper(root->left, nearestNeighbor, minDist, x, y);
-                    }
-                }else{
-                    findNearestNeighborHelper(root->left, nearestNeighbor, minDist, x, y);
-                    if(x + minDist > root->data.first){
-                        // x + record.minDist forms a circle. the circle in this case
-                        // encompasses this current node's coordinates, so we can get closer to the query node
-                        // by checking the right subtree
-                        findNearestNeighborHelper(root->right, nearestNeighbor, minDist, x, y);
-                    }
-                }
-            }else{
-                if(y > root->data.second){
-                    findNearestNeighborHelper(root->right, nearestNeighbor, minDist, x, y);
-                    if(y - minDist < root->data.second){
-                        findNearestNeighborHelper(root->left, nearestNeighbor, minDist, x, y);
-                    }
-                }else{
-                    findNearestNeighborHelper(root->left, nearestNeighbor, minDist, x, y);
-                    if(y + minDist > root->data.second){
-                        findNearestNeighborHelper(root->right, nearestNeighbor, minDist, x, y);
+        int top = cellRow - ring;
+        int bottom = cellRow + ring;
+        for(int row = std::max(0, top); row <= std::min(grid.rows - 1, bottom); row++){
+            // only the edge of the ring: every column on the top and bottom rows, otherwise the two ends
+            bool wholeRow = (row == top || row == bottom);
+            int step = wholeRow ? 1 : 2 * ring;
+            for(int col = cellCol - ring; col <= cellCol + ring; col += step){
+                if(col >= 0 && col < grid.cols){
+                    int cell = row * grid.cols + col;
+                    for(int i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; i++){
+                        long long dx = grid.seeds[i].x - x;
+                        long long dy = grid.seeds[i].y - y;
+                        long long dist = dx * dx + dy * dy;
+                        if(best == -1 || dist < bestDist || (dist == bestDist && grid.seedOrder[i] < grid.seedOrder[best])){
+                            best = i;
+                            bestDist = dist;
+                        }
                     }
                 }
             }
         }
     }
+    
+    return best;
 }
 
-// find nearest neighbor in 2d tree given a point's x and y coords and the tree's root 
-CustomPoint findNearestNeighbor(Node* root, int x, int y){
-    // set default values
-    CustomPoint nearestNeighbor = root->point;
-    float minDist = getDist(root->data.first, x, root->data.second, y);
+void findSeedCandidates(const SeedGrid& grid, int left, int top, int right, int bottom, std::vector<int>& candidates){
+    candidates.clear();
+    
+    // any pixel in the tile is at most halfDiagonal from the middle, so its nearest seed
+    // is no farther than the middle's nearest seed plus halfDiagonal
+    int midX = (left + right - 1) / 2;
+    int midY = (top + bottom - 1) / 2;
+    const CustomPoint& midSeed = grid.seeds[findNearestSeed(grid, midX, midY)];
+    
+    double midDist = std::sqrt((double)(midSeed.x - midX) * (midSeed.x - midX) + (double)(midSeed.y - midY) * (midSeed.y - midY));
+    double halfDiagonal = std::sqrt((double)std::max(midX - left, right - 1 - midX) * std::max(midX - left, right - 1 - midX) +
+                                    (double)std::max(midY - top, bottom - 1 - midY) * std::max(midY - top, bottom - 1 - midY));
+    long long radius = (long long)std::ceil(midDist + halfDiagonal) + 1; // rounded up to stay on the safe side
+    
+    // cells that overlap the tile grown by radius
+    int firstCol = std::max(0, (int)((left - radius - grid.minX) / grid.cellSize));
+    int lastCol = std::min(grid.cols - 1, (int)((right - 1 + radius - grid.minX) / grid.cellSize));
+    int firstRow = std::max(0, (int)((top - radius - grid.minY) / grid.cellSize));
+    int lastRow = std::min(grid.rows - 1, (int)((bottom - 1 + radius - grid.minY) / grid.cellSize));
     
-    findNearestNeighborHelper(root, nearestNeighbor, minDist, x, y);
+    for(int row = firstRow; row <= lastRow; row++){
+        for(int col = firstCol; col <= lastCol; col++){
+            int cell = row * grid.cols + col;
+            for(int i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; i++){
+                // distance from the seed to the closest pixel of the tile
+                long long dx = std::max(0, std::max(left - grid.seeds[i].x, grid.seeds[i].x - (right - 1)));
+                long long dy = std::max(0, std::max(top - grid.seeds[i].y, grid.seeds[i].y - (bottom - 1)));
+                if(dx * dx + dy * dy <= radius * radius){
+                    candidates.push_back(i);
+                }
+            }
+        }
+    }
     
-    return nearestNeighbor;
-}
\ No newline at end of file
+    std::sort(candidates.begin(), candidates.end(), [&grid](int a, int b){
+        return grid.seedOrder[a] < grid.seedOrder[b];
+    });
+}
@@ -23,15 +23,6 @@ struct CustomPoint {
 };
 
 
-// each node takes Point info (x, y, rgb) and a dimension (0 for 'x', 1 for 'y')
-struct Node {
-	std::pair<int, int> data; // [point.x, point.y];
-	CustomPoint point;
-	int dim;
-	Node* left = nullptr;
-	Node* right = nullptr;
-};
-
 std::pair<int, int> getPixelCoords(int index, int width, int height);
 
 // get distance between 2 points
@@ -39,23 +30,62 @@ std::pair<int, int> getPixelCoords(int index, int width, int height);
 // however, we don't really need the sqrt when used in getting nearest neighbors since we only want to find the minimum distance
 float getDist(int x1, int x2, int y1, int y2);
 
-// check if a Node is a leaf (both children are null)
-bool isLeaf(Node* n);
+// 2d tree stored flat in one array instead of as linked nodes.
+// the points in [lo, hi) form a subtree whose root is the middle one, mid = lo + (hi - lo)/2,
+// with the left subtree in [lo, mid) and the right subtree in [mid + 1, hi)
+struct KdTree {
+	std::vector<CustomPoint> points;
+	std::vector<int> pointOrder;         // index of each point in the list the tree was built from (for breaking ties)
+	std::vector<unsigned char> splitDim; // dimension each subtree root splits on (0 for 'x', 1 for 'y')
+};
+
+// build the tree in place (replacing whatever was in it before)
+// in this use case our dimensions will be x and y (since each pixel has an x,y coordinate), so only 2 dimensions.
+// each subtree splits on whichever of the two its points are more spread out in
+void build2dTree(KdTree& tree, const std::vector<CustomPoint>& pointsList);
 
-// recursive helper function to delete nodes of tree used in deleteTree
-void deleteHelper(Node* root);
+// index into tree.points of the point closest to (x, y), or -1 if the tree is empty.
+// if several are equally close, the one that came first in the list the tree was built from wins
+int findNearestNeighbor(const KdTree& tree, int x, int y);
 
-// delete all the nodes of a tree given the root 
-void deleteTree(Node*& root);
+// most neighbors findNearestNeighbors can look for per query
+#define KD_TREE_MAX_K 16
+
+// the k closest points to each of numQueries points (queryX[i], queryY[i]). the indices into tree.points of
+// query i's neighbors go in neighbors[i*k] to neighbors[i*k + k - 1], closest first and ties broken like
+// findNearestNeighbor, and their squared distances go in the same spots of neighborDists (which can be null).
+// spots past the number of points in the tree get -1. k has to be between 1 and KD_TREE_MAX_K.
+// meant for runs of queries next to each other, like a scanline or a tile: a few queries in a row share
+// one short list of points that could be their neighbors (found from the neighbors of the middle one,
+// starting from the previous run's as the best guess), so most queries don't walk the tree at all
+void findNearestNeighbors(const KdTree& tree, const int* queryX, const int* queryY, int numQueries, int k, int* neighbors, long long* neighborDists);
+
+// uniform grid of buckets for finding the nearest seed point to a pixel.
+// each cell holds the seeds that fall inside it, and a query only looks at the cells
+// around the pixel until no farther cell could hold anything closer
+struct SeedGrid {
+	int minX = 0;
+	int minY = 0;
+	int cellSize = 1;
+	int cols = 0;
+	int rows = 0;
+	std::vector<int> cellStart;       // seeds in cell c are seeds[cellStart[c]] to seeds[cellStart[c+1]-1]
+	std::vector<CustomPoint> seeds;   // grouped by cell
+	std::vector<int> seedOrder;       // index of each seed in the list the grid was built from (for breaking ties)
+};
 
-// returns the root of the resulting 2d tree 
-// in this use case our dimensions will be x and y (since each pixel has an x,y coordinate), so only 2 dimensions 
-Node* build2dTree(std::vector<CustomPoint> pointsList, int currDim);
+// the grid covers the seeds and every pixel of a width x height image
+void buildSeedGrid(SeedGrid& grid, const std::vector<CustomPoint>& seeds, int width, int height);
 
-// recursive helper function for finding nearest neighbor of a given point's x and y coords 
-void findNearestNeighborHelper(Node* root, CustomPoint& nearestNeighbor, float& minDist, int x, int y);
+// index into grid.seeds of the seed closest to (x, y). if several are equally close,
+// the one that came first in the list the grid was built from wins.
+// the grid must have at least one seed and (x, y) has to be inside the image
+int findNearestSeed(const SeedGrid& grid, int x, int y);
 
-// find nearest neighbor in 2d tree given a point's x and y coords and the tree's root 
-CustomPoint findNearestNeighbor(Node* root, int x, int y);
+// every seed that could be the nearest one to some pixel in columns [left, right) and rows [top, bottom)
+// (the seed nearest the middle of the tile limits how far away that can be). the indices into
+// grid.seeds come out in the order the seeds were added, so checking them in order and keeping the first
+// closest one breaks ties the same way findNearestSeed does
+void findSeedCandidates(const SeedGrid& grid, int left, int top, int right, int bottom, std::vector<int>& candidates);
 
 #endif 